@@ -1,6 +1,12 @@
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <glad/glad.h>
@@ -11,6 +17,28 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "maze.h"
+#include "flowfield.h"
+#include "pathfinding.h"
+#include "sim.h"
+#include "profiler.h"
+#include "gputimer.h"
+#include "hud.h"
+#include "benchmark.h"
+#include "glcount.h"
+#include "latency.h"
+#include "memtrack.h"
+#include "triplebuffer.h"
+#include "spscqueue.h"
+#include "jobs.h"
+#include "drawlist.h"
+#include "capture.h"
+#include "programcache.h"
+#include "shaders.h"
+#ifdef HEADLESS
+#include "headless.h"
+#endif
+
 using namespace std;
 
 struct VAO {
@@ -31,62 +59,80 @@ struct GLMatrices {
 	GLuint MatrixID;
 } Matrices;
 
-struct Rectangle
-{
-    float x,y=0,z;
-    VAO *rectangle;
-};
-typedef struct Rectangle Rectangle;
-Rectangle Rectangles[1000];
+GLuint programID;
 
-struct Obstacle 
+// Shaders are built into the program from the files of the same name (see
+// shaders.h in the Makefile); --shaders <dir> reads them from there instead
+const char *shaderdir = NULL;
+
+/* The source of shader file 'file' into 'code': read whole from
+   shaderdir if given, else the built-in copy. Says why on failure. */
+bool Shadersource (const char* file, std::string& code)
 {
-    float x,y,z;
-    VAO *obstacle;
-};
-typedef struct Obstacle Obstacle;
-Obstacle Obstacles[1000];
-GLuint programID;
+	if (!shaderdir) {
+		for (int i=0; builtinshaders[i].file; i++)
+			if (!strcmp(builtinshaders[i].file, file)) {
+				code = builtinshaders[i].source;
+				return true;
+			}
+		fprintf(stderr, "Shader %s is not built in\n", file);
+		return false;
+	}
+	std::string path = std::string(shaderdir) + "/" + file;
+	std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+	if (stream) {
+		stream.seekg(0, std::ios::end);
+		code.resize(stream.tellg());
+		stream.seekg(0, std::ios::beg);
+		if (stream.read(&code[0], code.size()))
+			return true;
+	}
+	fprintf(stderr, "Can not read shader %s\n", path.c_str());
+	return false;
+}
 
 /* Function to load Shaders - Use it as it is */
+/* The linked program is cached as <name>.program for <name>.vert, in the
+   --shaders directory if given, else in the per-user cache directory, and
+   loaded from there while the sources and the driver stay the same (see
+   programcache.h). Returns 0 if a source is missing. */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+	PROFILE_SCOPE(PHASE_LOAD_SHADERS);
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	std::string VertexShaderCode, FragmentShaderCode;
+	if (!Shadersource(vertex_file_path, VertexShaderCode) || !Shadersource(fragment_file_path, FragmentShaderCode))
+		return 0;
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
+	// No cache at all when there is nowhere to keep it
+	std::string CachePath = shaderdir ? std::string(shaderdir) : programCacheDir();
+	if (!CachePath.empty()) {
+		std::string name(vertex_file_path);
+		CachePath += "/" + name.substr(0, name.rfind('.')) + ".program";
 	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+	GLuint CachedProgramID = CachePath.empty() ? 0 : programCacheLoad(CachePath.c_str(), VertexShaderCode, FragmentShaderCode);
+	if (CachedProgramID) {
+		printf("Loaded program : %s\n", CachePath.c_str());
+		return CachedProgramID;
 	}
 
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
+	{
+	PROFILE_SCOPE(PHASE_COMPILE_SHADER);
 	char const * VertexSourcePointer = VertexShaderCode.c_str();
 	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
 	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
+	}
 	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
 	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
@@ -94,12 +140,15 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
+	{
+	PROFILE_SCOPE(PHASE_COMPILE_SHADER);
 	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
 	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
 	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
+	}
 	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
 	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
@@ -108,12 +157,16 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Link the program
 	fprintf(stdout, "Linking program\n");
 	GLuint ProgramID = glCreateProgram();
+	{
+	PROFILE_SCOPE(PHASE_LINK_PROGRAM);
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	programCacheHint(ProgramID);
 	glLinkProgram(ProgramID);
 
 	// Check the program
 	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	}
 	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
 	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
@@ -122,39 +175,142 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	if (Result == GL_TRUE && !CachePath.empty())
+		programCacheStore(CachePath.c_str(), ProgramID, VertexShaderCode, FragmentShaderCode);
+
 	return ProgramID;
 }
 
-static void error_callback(int error, const char* description)
+bool memcheck = false;
+void Deletemodels ();
+
+/* The sim runs on 'simthread' unless a benchmark is playing; every tick
+   publishes a snapshot that draw() reads */
+thread simthread;
+atomic<bool> simrunning(false), gameover(false);
+TripleBuffer<SimSnapshot> snapshots;
+
+void Stopsim ()
 {
-    fprintf(stderr, "Error: %s\n", description);
+    simrunning=false;
+    if(simthread.joinable())
+        simthread.join();
 }
 
-void quit(GLFWwindow *window)
+/* Start-up loading runs on 'loaderthread', in a hidden window's context
+   sharing the main one's objects, while the main thread shows the loading
+   screen; 'loadsteps' counts the steps it has finished. The thread then
+   stays on to make each next level ahead of time. */
+thread loaderthread;
+GLFWwindow* loadercontext = NULL;
+GLFWwindow* gamewindow = NULL;      // the main window, destroyed by Exitgame()
+atomic<int> loadsteps(0);
+atomic<bool> loaded(false);
+
+/* The level being played and the next one. A slot is free until the
+   loader has generated and meshed a level in it, ready from then on, with
+   'levelfences' telling when the GPU has its buffers, and playing once
+   Nextlevel() enters it. The main thread frees a slot when it first draws
+   the level after it. */
+enum LevelState {
+    LEVEL_FREE = 0,
+    LEVEL_READY,
+    LEVEL_PLAYING
+};
+Level levels[2];
+GLsync levelfences[2];
+atomic<int> levelstates[2];
+mutex levellock;
+condition_variable levelfreed;
+bool loaderstopping = false;
+
+void Stoploader ()
+{
+    if(!loaderthread.joinable())
+        return;
+    {
+        lock_guard<mutex> guard(levellock);
+        loaderstopping=true;
+    }
+    levelfreed.notify_one();
+    loaderthread.join();
+    glfwDestroyWindow(loadercontext);
+}
+
+/* Every way out of the game: report timings, write the trace and quit.
+   With --memcheck, any allocation made in the frame loop fails the run. */
+void Exitgame ()
 {
-    glfwDestroyWindow(window);
+    // On the sim thread: let the main loop end the game after this tick
+    if (this_thread::get_id() == simthread.get_id()) {
+        gameover = true;
+        return;
+    }
+    Stopsim ();
+    Stoploader ();
+    memLoopEnd ();
+    captureFinish ();
+    Deletemodels ();
+    if (gamewindow)
+        glfwDestroyWindow(gamewindow);
+    gamewindow = NULL;
+    profileReport(stdout);
+    latencyReport(stdout);
+    captureReport(stdout);
+    glCountReport(stdout);
+    memReport(stdout);
+    jobsReport(stdout);
+    jobsShutdown ();
+    traceFinish();
+    if (memcheck && memLoopAllocations()) {
+        fprintf(stderr, "memcheck: the frame loop allocated memory\n");
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
 
+void quit(GLFWwindow *window)
+{
+    Exitgame ();
+}
+
 
-/* Generate VAO, VBOs and return VAO handle */
-struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+/* Generate the VBOs of a VAO handle, without the VAO itself. Contexts
+   sharing objects share buffers, so this can run on the loader thread. */
+struct VAO* create3DBuffers (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
 {
     struct VAO* vao = new struct VAO;
     vao->PrimitiveMode = primitive_mode;
     vao->NumVertices = numVertices;
     vao->FillMode = fill_mode;
+    vao->VertexArrayID = 0;
 
-    // Create Vertex Array Object
-    // Should be done after CreateWindow and before any other GL calls
-    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
     glGenBuffers (1, &(vao->VertexBuffer)); // VBO - vertices
     glGenBuffers (1, &(vao->ColorBuffer));  // VBO - colors
 
-    glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
     glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
     glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), vertex_buffer_data, GL_STATIC_DRAW); // Copy the vertices into VBO
+    memGpuBuffer (vao->VertexBuffer, 3*numVertices*sizeof(GLfloat));
+
+    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
+    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
+    memGpuBuffer (vao->ColorBuffer, 3*numVertices*sizeof(GLfloat));
+
+    return vao;
+}
+
+/* Generate the VAO over the VBOs of 'vao'. Vertex arrays are never shared
+   between contexts: this has to run in the context that draws it. */
+void create3DVertexArray (struct VAO* vao)
+{
+    // Create Vertex Array Object
+    // Should be done after CreateWindow and before any other GL calls
+    glGenVertexArrays(1, &(vao->VertexArrayID)); // VAO
+    glBindVertexArray (vao->VertexArrayID); // Bind the VAO 
+
+    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer); // Bind the VBO vertices 
     glVertexAttribPointer(
                           0,                  // attribute 0. Vertices
                           3,                  // size (x,y,z)
@@ -165,7 +321,6 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
                           );
 
     glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer); // Bind the VBO colors 
-    glBufferData (GL_ARRAY_BUFFER, 3*numVertices*sizeof(GLfloat), color_buffer_data, GL_STATIC_DRAW);  // Copy the vertex colors
     glVertexAttribPointer(
                           1,                  // attribute 1. Color
                           3,                  // size (r,g,b)
@@ -174,7 +329,13 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
                           0,                  // stride
                           (void*)0            // array buffer offset
                           );
+}
 
+/* Generate VAO, VBOs and return VAO handle */
+struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat* color_buffer_data, GLenum fill_mode=GL_FILL)
+{
+    struct VAO* vao = create3DBuffers(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+    create3DVertexArray (vao);
     return vao;
 }
 
@@ -188,12 +349,32 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
         color_buffer_data [3*i + 2] = blue;
     }
 
-    return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+    // GL keeps its own copy of the colours
+    struct VAO* vao = create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+    delete [] color_buffer_data;
+    return vao;
+}
+
+/* Free the VBOs and VAO of an object made by create3DObject */
+void delete3DObject (struct VAO* vao)
+{
+    if (!vao)
+        return;
+    memGpuFree (vao->VertexBuffer);
+    memGpuFree (vao->ColorBuffer);
+    glDeleteBuffers (1, &vao->VertexBuffer);
+    glDeleteBuffers (1, &vao->ColorBuffer);
+    glDeleteVertexArrays (1, &vao->VertexArrayID);
+    delete vao;
 }
 
 /* Render the VBOs handled by VAO */
 void draw3DObject (struct VAO* vao)
 {
+    renderstats.drawcalls++;
+    renderstats.statechanges += 6;
+    renderstats.triangles += vao->PrimitiveMode == GL_TRIANGLES ? vao->NumVertices/3 : 0;
+
     // Change the Fill Mode for this object
     glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
 
@@ -222,23 +403,98 @@ float triangle_rot_dir = 1;
 float rectangle_rot_dir = 1;
 bool triangle_rot_status = true;
 bool rectangle_rot_status = true;
-float player_rot = 0, dir = 1;
-float x = -7, z = 6, y = 2, t = 0.1;
 float camera_x = 1, camera_y = 5, camera_z = 0;
 float angle_xz = 90, camera_dist_xz = 10, camera_dist_yz = 7, angle_yz = 0;
-int state1 = 0, state2 = 0, state3 = 0, state4 = 0, state5 = 0, state6 = 0, state7 = 0, state8 = 0, space = 0;
 int view = 0;
-int b[500]={0};
 double xpos, ypos;
 float zoom=1;
-int a[500]={0};
-int st = 0, st1 = 0;
-int t1 = 0;
+
+/* Input for the sim. The GLFW callbacks run on the main thread and push
+   each event with the time it came in; the sim takes every event older
+   than the tick at the start of the tick, in order, so the tick never sees
+   input change halfway and a key let go before the tick still counts. */
+enum InputType {
+    INPUT_KEY_DOWN = 0,     // value: n for the key of state<n>
+    INPUT_KEY_UP,
+    INPUT_JUMP,
+    INPUT_SPEED,            // value: 1 faster, -1 slower
+    INPUT_VIEW              // value: the new view
+};
+struct InputEvent {
+    long long time;         // profileNow() when it came in
+    InputType type;
+    int value;
+};
+SpscQueue<InputEvent, 256> inputs;
+int simkeys = 0;            // bit n-1 set while the key of state<n> is down
+int simview = 0;            // the sim's copy of 'view'
+
+void Pushinput (InputType type, int value=0)
+{
+    InputEvent e = {profileNow(), type, value};
+    static bool warned = false;
+    if(!inputs.push(e)&&!warned)
+    {
+        cerr<<"Input queue full, dropping input"<<endl;
+        warned=true;
+    }
+}
+
+void Takeinput ()
+{
+    long long now=profileNow();
+    int pressed=0;          // keys down at some point since the last tick
+    for(const InputEvent *e; (e=inputs.peek())&&e->time<=now; inputs.pop())
+        switch(e->type)
+        {
+            case INPUT_KEY_DOWN:
+                simkeys|=1<<(e->value-1);
+                pressed|=1<<(e->value-1);
+                break;
+            case INPUT_KEY_UP:
+                simkeys&=~(1<<(e->value-1));
+                break;
+            case INPUT_JUMP:
+                space=1;
+                break;
+            case INPUT_SPEED:
+                if(e->value>0)
+                {
+                    t+=0.2;
+                    if(t>=0.2)
+                      t=0.2;
+                }
+                else
+                {
+                    t-=0.2;
+                    if(t<=0.5)
+                      t=0.2;
+                }
+                break;
+            case INPUT_VIEW:
+                simview=e->value;
+                break;
+        }
+    int keys=simkeys|pressed;
+    state1=keys&1;
+    state2=keys>>1&1;
+    state3=keys>>2&1;
+    state4=keys>>3&1;
+    state5=keys>>4&1;
+    state6=keys>>5&1;
+    state7=keys>>6&1;
+    state8=keys>>7&1;
+}
+
+void Showhint ();
+
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
      // Function is called first on GLFW_PRESS.
+    if (action != GLFW_REPEAT)
+        latencyInput ();
 
     if (action == GLFW_RELEASE) {
         switch (key) {
@@ -251,61 +507,62 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
             case GLFW_KEY_X:
                 // do something ..
                 break;
+            case GLFW_KEY_G:
+                Showhint ();
+                break;
+            case GLFW_KEY_T:
+                profileReport(stdout);
+                latencyReport(stdout);
+                glCountReport(stdout);
+                jobsReport(stdout);
+                break;
+            case GLFW_KEY_H:
+                hudvisible = !hudvisible;
+                break;
             case GLFW_KEY_UP:
-                state1 = 0;
+                Pushinput (INPUT_KEY_UP, 1);
                 break;
             case GLFW_KEY_DOWN:
-                state2 = 0;
+                Pushinput (INPUT_KEY_UP, 2);
                 break;
             case GLFW_KEY_LEFT:
-                state3 = 0;
+                Pushinput (INPUT_KEY_UP, 3);
                 break;
             case GLFW_KEY_RIGHT:
-                state4 = 0;
+                Pushinput (INPUT_KEY_UP, 4);
                 break;
             case GLFW_KEY_F:
-                t+=0.2;
-                if(t>=0.2)
-                  t=0.2;
+                Pushinput (INPUT_SPEED, 1);
                 break;
             case GLFW_KEY_S:
-                t-=0.2;
-                if(t<=0.5)
-                  t=0.2;
+                Pushinput (INPUT_SPEED, -1);
                 break;
             case GLFW_KEY_W:
                 //angle_xz++;
-                state5 = 0;
+                Pushinput (INPUT_KEY_UP, 5);
                 break;
             case GLFW_KEY_E:
                 //angle_xz--;
-                state6 = 0;
+                Pushinput (INPUT_KEY_UP, 6);
                 break;
             case GLFW_KEY_D:
-                state7 = 0;
+                Pushinput (INPUT_KEY_UP, 7);
                 //camera_y-=0.2;
                 break;
             case GLFW_KEY_A:
-                state8 = 0;
+                Pushinput (INPUT_KEY_UP, 8);
                 //camera_y+=0.2;
                 break;
             case GLFW_KEY_SPACE:
-                space = 1;
+                Pushinput (INPUT_JUMP);
                 break;
             case GLFW_KEY_1:
-                view=1;
-                break;
             case GLFW_KEY_2:
-                view=2;
-                break;
             case GLFW_KEY_3:
-                view=3;
-                break;
             case GLFW_KEY_4:
-                view=4;
-                break;
             case GLFW_KEY_5:
-                view=5;
+                view=key-GLFW_KEY_1+1;
+                Pushinput (INPUT_VIEW, view);
                 break;
             default:
                 break;
@@ -317,31 +574,31 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
                 quit(window);
                 break;
             case GLFW_KEY_UP:
-                state1 = 1;
+                Pushinput (INPUT_KEY_DOWN, 1);
                 break;
             case GLFW_KEY_DOWN:
-                state2 = 1;
+                Pushinput (INPUT_KEY_DOWN, 2);
                 break;
             case GLFW_KEY_LEFT:
-                state3 = 1;
+                Pushinput (INPUT_KEY_DOWN, 3);
                 break;
             case GLFW_KEY_RIGHT:
-                state4 = 1;
+                Pushinput (INPUT_KEY_DOWN, 4);
                 break;
             case GLFW_KEY_W:
                 //angle_xz++;
-                state5 = 1;
+                Pushinput (INPUT_KEY_DOWN, 5);
                 break;
             case GLFW_KEY_E:
                 //angle_xz--;
-                state6 = 1;
+                Pushinput (INPUT_KEY_DOWN, 6);
                 break;
             case GLFW_KEY_D:
-                state7 = 1;
+                Pushinput (INPUT_KEY_DOWN, 7);
                 //camera_y-=0.2;
                 break;
             case GLFW_KEY_A:
-                state8 = 1;
+                Pushinput (INPUT_KEY_DOWN, 8);
                 //camera_y+=0.2;
                 break;            
             default:
@@ -366,6 +623,7 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
 /* Executed when a mouse button is pressed/released */
 void mouseButton (GLFWwindow* window, int button, int action, int mods)
 {
+    latencyInput ();
     switch (button) {
         case GLFW_MOUSE_BUTTON_LEFT:
             if (action == GLFW_RELEASE)
@@ -428,10 +686,10 @@ void createTriangle ()
     0,0,1, // color 2
   };
 
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  triangle = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_LINE);
+  // create3DBuffers returns a VAO handle with its VBOs; Createvertexarrays() adds the VAO
+  triangle = create3DBuffers(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_LINE);
 }
-void createObstacle ()
+void createObstacle (Level& level)
 {
     static const GLfloat vertex_buffer_data [] = {
         -0.25,0,0.25, // vertex 1
@@ -533,15 +791,15 @@ void createObstacle ()
         1,1,1,
         1,1,1
     };
-    for(int i=0;i<200;i++)
+    for(int i=0;i<level.ntiles;i++)
     {
-        if(b[i]==1)
-            Obstacles[i].obstacle = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
+        if(level.b[i]==1)
+            level.obstacles[i].obstacle = create3DBuffers(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
     }
 
 }
 // Creates the rectangle object used in this sample code
-void createRectangle ()
+void createRectangle (Level& level)
 {
   // GL3 accepts only Triangles. Quads are not supported
   static const GLfloat vertex_buffer_data [] = {
@@ -645,10 +903,10 @@ void createRectangle ()
     1,0,0  
   };
 
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  for(int i=0;i<1000;i++)
+  // create3DBuffers returns a VAO handle with its VBOs; Createvertexarrays() adds the VAO
+  for(int i=0;i<level.ntiles;i++)
   {
-    if (i==13)
+    if (i==level.goaltile)
     {        
         for(int j=0;j<=17;)
         {
@@ -678,7 +936,7 @@ void createRectangle ()
         color_buffer_data[16]=0;
         color_buffer_data[17]=0;
     }
-    Rectangles[i].rectangle = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
+    level.tiles[i].rectangle = create3DBuffers(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
   }
 }
 
@@ -786,25 +1044,44 @@ void createPlayer ()
     0,255,0  
   };
 
-  // create3DObject creates and returns a handle to a VAO that can be used later
+  // create3DBuffers returns a VAO handle with its VBOs; Createvertexarrays() adds the VAO
 
-  player = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
+  player = create3DBuffers(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
 float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
 
-/* Render the scene with openGL */
+// This frame's tile and obstacle draws, recorded by jobs in draw()
+FrameDraws framedraws;
+
+/* Draw one recorded command with its MVP */
+void Replaydraw (const DrawCommand& command)
+{
+  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &command.mvp[0][0]);
+  renderstats.statechanges++;
+  draw3DObject(command.vao);
+}
+
+/* Render the scene with openGL as of the sim snapshot 'sim' */
 /* Edit this function according to your assignment */
-void draw ()
+void draw (const SimSnapshot &sim)
 {
+  gpuTimersBeginFrame ();
+  hudFrame ();
+  renderstats = RenderStats();
+
   // clear the color and depth in the frame buffer
-  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  {
+    GPU_SCOPE(PHASE_GPU_CLEAR);
+    glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  }
 
   // use the loaded shader program
   // Don't change unless you know what you are doing
   glUseProgram (programID);
+  renderstats.statechanges++;
   //if(view==1)
   // Eye - Location of camera. Don't change unless you are sure!!
   glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
@@ -819,8 +1096,8 @@ void draw ()
     //if(dir==1)
     //{
     Matrices.projection = glm::ortho(-4.0f, 4.0f, -2.25f, 2.25f, 0.0f, 500.0f);
-        glm::vec3 eye (x,5,z);
-        glm::vec3 target(x+8,-2,z-8);
+        glm::vec3 eye (sim.x,5,sim.z);
+        glm::vec3 target(sim.x+8,-2,sim.z-8);
         Matrices.view = glm::lookAt(eye, target, glm::vec3(0,1,0));
     //}
         /*
@@ -846,8 +1123,8 @@ void draw ()
   else if(view==2)
   {
     Matrices.projection = glm::ortho(-4.0f, 4.0f, -2.25f, 2.25f, 0.0f, 500.0f);
-    glm::vec3 eye (x,2,z+2);
-    glm::vec3 target(x,1,z);
+    glm::vec3 eye (sim.x,2,sim.z+2);
+    glm::vec3 target(sim.x,1,sim.z);
     Matrices.view = glm::lookAt(eye, target, glm::vec3(0,1,0));
   }
   //cout<<dir<<endl;
@@ -916,53 +1193,49 @@ void draw ()
   
   Matrices.model = glm::mat4(1.0f);
 
-  glm::mat4 translatePlayer = glm::translate (glm::vec3(x, y-1, z));        // glTranslatef
-  glm::mat4 rotatePlayer = glm::rotate((float)(player_rot*M_PI/180.0f), glm::vec3(0,1,0)); // rotate about vector (-1,1,1)
+  {
+  GPU_SCOPE(PHASE_GPU_PLAYER);
+  glm::mat4 translatePlayer = glm::translate (glm::vec3(sim.x, sim.y-1, sim.z));        // glTranslatef
+  glm::mat4 rotatePlayer = glm::rotate((float)(sim.player_rot*M_PI/180.0f), glm::vec3(0,1,0)); // rotate about vector (-1,1,1)
   Matrices.model = (translatePlayer * rotatePlayer);
   MVP = VP * Matrices.model;
   glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+  renderstats.statechanges++;
   // draw3DObject draws the VAO given to it using current MVP matrix
   draw3DObject(player);
+  }
   
-  for(int k=-7,i=0;k<7;k++)
+  // Tiles and obstacles are culled and their MVPs worked out by jobs, a
+  // chunk of the field each, then drawn here in chunk order
   {
-    
-    for(int j=-7;j<7;j++)
-    {
-      
-      if(((j==2)&&(k==-1))||((j==0)&&(k==1))||((j==-3)&&(k==3))||((j==-2)&&(k==5))||((j==4)&&(k==-4))||((j==-2)&&(k==-1)));
-      else
-      {
-        Matrices.model = glm::mat4(1.0f);
-        Rectangles[i].x=j;
-        Rectangles[i].z=k;
-        glm::mat4 translateRectangle = glm::translate (glm::vec3(j, Rectangles[i].y, k));        // glTranslatef
-        //glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-        Matrices.model = translateRectangle;
-        MVP = VP * Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        // draw3DObject draws the VAO given to it using current MVP matrix
-        draw3DObject(Rectangles[i].rectangle);
-        i++;
-        //cout<<j<<" "<<k<<endl;
-
-      }
-    }
-  } 
-  for(int i=0;i<200;i++)
+  PROFILE_SCOPE(PHASE_RECORD_DRAWS);
+  recordDraws(framedraws, sim, VP);
+  }
   {
-    if(b[i]==1)
-    {
-        Obstacles[i].x=Rectangles[i].x;
-        Obstacles[i].z=Rectangles[i].z;
-        Obstacles[i].y=0.5;
-        Matrices.model = glm::mat4(1.0f);
-        glm::mat4 translateRectangle = glm::translate (glm::vec3(Obstacles[i].x, Obstacles[i].y, Obstacles[i].z));
-        Matrices.model = translateRectangle;
-        MVP = VP * Matrices.model;
-        glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        draw3DObject(Obstacles[i].obstacle);
-    }
+  GPU_SCOPE(PHASE_GPU_TILES);
+  for(int c=0;c<framedraws.nchunks;c++)
+  {
+    const DrawList &list = framedraws.chunks[c];
+    for(int i=0;i<list.ntiles;i++)
+        Replaydraw(list.tiles[i]);
+    renderstats.culled += list.culled;
+  }
+  }
+  {
+  GPU_SCOPE(PHASE_GPU_OBSTACLES);
+  for(int c=0;c<framedraws.nchunks;c++)
+  {
+    const DrawList &list = framedraws.chunks[c];
+    for(int i=0;i<list.nobstacles;i++)
+        Replaydraw(list.obstacles[i]);
+  }
+  }
+
+  // Performance overlay goes on top of the finished scene
+  if(hudvisible)
+  {
+    GPU_SCOPE(PHASE_GPU_HUD);
+    hudDraw (Matrices.MatrixID);
   }
   // Increment angles
   float increments = 1;
@@ -972,10 +1245,17 @@ void draw ()
   rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
 }
 
+#ifndef HEADLESS
+static void error_callback(int error, const char* description)
+{
+    fprintf(stderr, "Error: %s\n", description);
+}
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
 {
+    PROFILE_SCOPE(PHASE_INITGLFW);
     GLFWwindow* window; // window desciptor/handle
 
     glfwSetErrorCallback(error_callback);
@@ -997,6 +1277,7 @@ GLFWwindow* initGLFW (int width, int height)
 
     glfwMakeContextCurrent(window);
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+    glCountInit();
     glfwSwapInterval( 1 );
 
     /* --- register callbacks with GLFW --- */
@@ -1019,23 +1300,190 @@ GLFWwindow* initGLFW (int width, int height)
 
     return window;
 }
+#endif
+
+/* Make the next level in every free slot until Stoploader(). Only this
+   thread calls rand() meanwhile, so a seed still gives the same levels. */
+void Makelevels ()
+{
+    for(;;)
+    {
+        int slot;
+        {
+            unique_lock<mutex> guard(levellock);
+            levelfreed.wait(guard, [] { return loaderstopping || levelstates[0]==LEVEL_FREE || levelstates[1]==LEVEL_FREE; });
+            if(loaderstopping)
+                return;
+            slot=levelstates[0]==LEVEL_FREE ? 0 : 1;
+        }
+        Level &level=levels[slot];
+        {
+            MEM_SCOPE(MEM_LEVELS);
+            Generatelevel (level, true);
+        }
+        {
+            PROFILE_SCOPE(PHASE_CREATE_MODELS);
+            MEM_SCOPE(MEM_INSTANCES);
+            createRectangle (level);
+            createObstacle (level);
+        }
+        levelfences[slot]=glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush ();
+        levelstates[slot].store (LEVEL_READY, memory_order_release);
+    }
+}
+
+/* The loader thread: the first level, the models' buffers and the
+   shaders, then the levels after it. The fence tells the main thread when
+   the GPU has the first lot. */
+const int LOAD_STEPS = 5;
+GLsync loadfence;
+
+void Loadassets ()
+{
+    memBackgroundThread ();
+    glfwMakeContextCurrent (loadercontext);
+    {
+        MEM_SCOPE(MEM_LEVELS);
+        Generatelevel (levels[0]);
+    }
+    Enterlevel (levels[0]);     // the sim has not started yet
+    levelstates[0]=LEVEL_PLAYING;
+    loadsteps++;
+
+    // Can the pink goal tile be reached on foot from the start?
+    vector<int> path;
+    if(findPathJPS(grid, worldToCell(grid, -7, 6), worldToCell(grid, 6, -7), path))
+        cout<<"Shortest walk to goal: "<<pathLength(path)<<" tiles\n";
+    else
+        cout<<"Goal not reachable without jumping\n";
+
+    // Create the models
+    {
+        PROFILE_SCOPE(PHASE_CREATE_MODELS);
+        {
+            MEM_SCOPE(MEM_MESHES);
+            createTriangle (); // Generate the VBOs, vertices data & copy into the array buffer
+            createPlayer ();
+        }
+        loadsteps++;
+        MEM_SCOPE(MEM_INSTANCES);
+        createRectangle (levels[0]);
+        loadsteps++;
+        createObstacle (levels[0]);
+    }
+    loadsteps++;
+
+    // Create and compile our GLSL program from the shaders
+    {
+        MEM_SCOPE(MEM_SHADERS);
+        programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+    }
+    loadsteps++;
+
+    loadfence = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush ();
+    loaded.store (true, memory_order_release);
+
+    Makelevels ();
+    glfwMakeContextCurrent (NULL);
+}
+
+/* The loading screen: a progress bar drawn with scissored clears, so it
+   needs no shader or model of its own */
+void Drawloading (GLFWwindow* window)
+{
+    int fbwidth, fbheight;
+    glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+    int barx=fbwidth/4, bary=fbheight/2-fbheight/60, barwidth=fbwidth/2, barheight=fbheight/30;
+
+    glClearColor (0.3f, 0.3f, 0.3f, 0.0f);
+    glClear (GL_COLOR_BUFFER_BIT);
+    glEnable (GL_SCISSOR_TEST);
+    glScissor (barx, bary, barwidth, barheight);
+    glClearColor (0.1f, 0.1f, 0.1f, 0.0f);
+    glClear (GL_COLOR_BUFFER_BIT);
+    glScissor (barx, bary, barwidth*loadsteps/LOAD_STEPS, barheight);
+    glClearColor (0.6f, 0.0f, 0.6f, 0.0f);
+    glClear (GL_COLOR_BUFFER_BIT);
+    glDisable (GL_SCISSOR_TEST);
+}
+
+/* Give every model of 'level' its VAO, in the drawing context */
+void Createvertexarrays (Level& level)
+{
+    for(int i=0;i<level.ntiles;i++)
+    {
+        create3DVertexArray (level.tiles[i].rectangle);
+        if(level.obstacles[i].obstacle)
+            create3DVertexArray (level.obstacles[i].obstacle);
+    }
+}
+
+void Deletelevelmodels (Level& level)
+{
+    for(int i=0;i<level.ntiles;i++)
+    {
+        delete3DObject (level.tiles[i].rectangle);
+        delete3DObject (level.obstacles[i].obstacle);
+        level.tiles[i].rectangle=NULL;
+        level.obstacles[i].obstacle=NULL;
+    }
+}
+
+/* The level draw() last drew. The first time a snapshot shows the next
+   one, its VAOs are made once the GPU has its buffers, and the level it
+   replaces is freed for the loader to make the one after. */
+const Level* drawnlevel = NULL;
+
+void Showlevel (const Level* level)
+{
+    int slot=level-levels;
+    glWaitSync (levelfences[slot], 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync (levelfences[slot]);
+    Createvertexarrays (levels[slot]);
+    int old=drawnlevel-levels;
+    Deletelevelmodels (levels[old]);
+    {
+        lock_guard<mutex> guard(levellock);
+        levelstates[old]=LEVEL_FREE;
+    }
+    levelfreed.notify_one();
+    drawnlevel=level;
+}
+
+/* On the sim thread, from Win(): play the level the loader made next */
+int playinglevel = 0;
+
+bool Nextlevel ()
+{
+    int next=1-playinglevel;
+    if(levelstates[next].load(memory_order_acquire)!=LEVEL_READY)
+        return false;
+    levelstates[next]=LEVEL_PLAYING;
+    playinglevel=next;
+    Enterlevel (levels[next]);
+    return true;
+}
 
-/* Initialize the OpenGL rendering properties */
-/* Add all the models to be created here */
+/* Initialize the OpenGL rendering properties, once Loadassets() is done */
 void initGL (GLFWwindow* window, int width, int height)
 {
-    /* Objects should be created before any other gl function and shaders */
-	// Create the models
-	createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
-	createRectangle ();
-	createPlayer ();
-    createObstacle ();
-    
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+    PROFILE_SCOPE(PHASE_INITGL);
+    // Wait for the loader's buffers and program before using them here
+    glWaitSync (loadfence, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync (loadfence);
+    create3DVertexArray (triangle);
+    create3DVertexArray (player);
+    Createvertexarrays (levels[0]);
+    drawnlevel=&levels[0];
+
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
 
+	gpuTimersInit ();
+	hudInit ();
+
 	
 	reshapeWindow (window, width, height);
 
@@ -1051,119 +1499,22 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "VERSION: " << glGetString(GL_VERSION) << endl;
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
-void playeradventure ()
+/* Free every model, once the loader has stopped */
+void Deletemodels ()
 {
-    if(state1==1)
-        {
-            //if(dir==1)
-            //    x+=t;
-            //else if(dir==2)
-            z-=t;
-            //else if(dir==3)
-            //    x-=t;
-            //else if(dir==4)
-            //    z+=t;
-            dir=2;
-            if(dir==1)
-            {
-                player_rot = 90;
-                dir=2;
-            }
-            else if(dir==3)
-            {
-                player_rot = -90;
-                dir=2;
-            }
-            else if(dir==4)
-            {
-                player_rot = 180;
-                dir=2;
-            }
-        }
-        if(state2==1)
-        {
-            z+=t;
-            dir=4;
-            if(dir==1)
-            {
-                player_rot = -90;
-                dir=4;
-            }
-            if(dir==2)
-            {
-                player_rot = 180;
-                dir=4; 
-            }
-            if(dir==3)
-            {
-                player_rot = 90;
-                dir=4;
-            }
-        }
-        if(state3==1)
-        {
-            x-=t;
-            dir=3;
-            if(dir==1)
-            {
-                player_rot = 180;
-                dir=3;
-            }
-            if(dir==2)
-            {
-                player_rot = 90;
-                dir=3;
-            }
-            if(dir==4)
-            {
-                player_rot = -90;
-                dir=3;
-            }
-        }
-        if(state4==1)
-        {
-            x+=t; 
-            dir=1;
-            if(dir==2)
-            {
-                player_rot = -90;
-                dir=1;
-            }     
-            if(dir==3)
-            {
-                player_rot = 180;
-                dir=1;
-            }
-            if(dir==4)
-            {
-                player_rot = 90;
-                dir=1;
-            }
-        }    
-} 
-void playerheaddir ()
-{
-    if(state1==1)
-        {
-            z-=t;
-            
-        }
-        if(state2==1)
-        {
-            z+=t;
-            
-        }
-        if(state3==1)
-        {
-            x-=t;
-            
-        }
-        if(state4==1)
+    delete3DObject (triangle);
+    delete3DObject (player);
+    triangle=player=NULL;
+    for(int i=0;i<2;i++)
+    {
+        Deletelevelmodels (levels[i]);
+        if(levelstates[i]==LEVEL_READY&&levelfences[i])
         {
-            x+=t; 
-            
+            glDeleteSync (levelfences[i]);
+            levelfences[i]=NULL;
         }
-}  
+    }
+}
 void helicopterview ()
 {
     if(state5==1)
@@ -1177,6 +1528,7 @@ void helicopterview ()
 }
 void scroll(GLFWwindow* window, double x,double y)
 {
+    latencyInput ();
     if(y>0)
         zoom*=1.1;
     else if(y<0&&zoom>0)
@@ -1186,155 +1538,250 @@ void scroll(GLFWwindow* window, double x,double y)
     //cout<<y<<endl;
 
 }
-void Obstacleblock ()
+/* Print a walking route to the goal that times the piles */
+void Showhint ()
 {
-    for(int i=0;i<200;i++)
-        {
-            if(b[i]==1&&space==0)
-            {
-                if(z<=Obstacles[i].z+0.5&&z>=Obstacles[i].z-0.5)
-                {
-                    if(x-Obstacles[i].x<=0.5&&x-Obstacles[i].x>=0.25)
-                        x=Obstacles[i].x+0.5;
-                    else if(Obstacles[i].x-x<=0.5&&Obstacles[i].x-x>=0.25)
-                        x=Obstacles[i].x-0.5;
-                }
-                if(x<=Obstacles[i].x+0.5&&x>=Obstacles[i].x-0.5)
-                {
-                    if(z-Obstacles[i].z<=0.5&&z-Obstacles[i].z>=0.25)
-                        z=Obstacles[i].z+0.5;
-                    else if(Obstacles[i].z-z<=0.5&&Obstacles[i].z-z>=0.25)
-                        z=Obstacles[i].z-0.5;
-                }
-            }
-        }
-
+    const SimSnapshot &sim=snapshots.read();
+    const Grid &grid=sim.level->grid;
+    int from=worldToCell(grid, sim.x, sim.z), goal=worldToCell(grid, 6, -7);
+    int ticks_per_cell=(int)ceil(1/sim.speed);
+    vector<TimedStep> route;
+    if(from==-1||!findPathSpaceTime(grid, from, goal, sim.piletick, ticks_per_cell, 5000, route))
+    {
+        cout<<"Hint: no walking route from here\n";
+        return;
+    }
+    cout<<"Hint ("<<fieldDistance(sim.level->goalfield, from)<<" tiles, "<<route.back().tick-sim.piletick<<" ticks):";
+    for(size_t s=1;s<route.size();)
+    {
+        int d=route[s].cell-route[s-1].cell;
+        size_t e=s;
+        while(e<route.size()&&route[e].cell-route[e-1].cell==d)
+            e++;
+        const char *move = d==0 ? "wait" : d==1 ? "right" : d==-1 ? "left" : d>0 ? "down" : "up";
+        cout<<" "<<move<<" "<<(d==0 ? route[e-1].tick-route[s-1].tick : (long)(e-s));
+        s=e;
+    }
+    cout<<endl;
 }
-void Movingpilesblock ()
+/* Scripted benchmark (--bench <file.json>): a fixed level, then the same
+   walk and camera moves through every view for a fixed number of frames.
+   Sim ticks follow the frame count instead of the clock, so every run
+   does the same work whatever the frame rate. */
+struct Benchstep {
+    const char *name;
+    int frames, view;
+    bool walk;                  // steer the player along the goal field
+    float zoom_from, zoom_to;   // helicopter zoom over the step
+};
+const Benchstep benchscript[] = {
+    {"warmup", 60, 0, false, 1, 1},
+    {"adventure", 300, 1, true, 1, 1},
+    {"follow", 300, 2, true, 1, 1},
+    {"tower", 240, 3, true, 1, 1},
+    {"top", 240, 4, true, 1, 1},
+    {"helicopter", 240, 5, false, 1, 1},
+    {"helicopter zoom", 240, 5, false, 1, 0.4},
+};
+const int nbenchsteps = sizeof(benchscript)/sizeof(benchscript[0]);
+const int benchticks = 4;       // frames per sim tick, about 0.065 s at 60 Hz
+const char *benchpath = NULL;
+BenchRun benchrun;
+int benchstep = 0, benchstepframe = 0;
+long benchframes = 0;
+
+int Benchlength ()
 {
-    for(int i=0;i<200;i++)
-        {
-            if(a[i]==1&&space==0)
-            {
-                if(z<=Rectangles[i].z+0.5&&z>=Rectangles[i].z-0.5)
-                {
-                    if(x-Rectangles[i].x<=0.75&&x-Rectangles[i].x>=0.5)
-                        x=Rectangles[i].x+0.75;
-                    else if(Rectangles[i].x-x<=0.75&&Rectangles[i].x-x>=0.5)
-                        x=Rectangles[i].x-0.75;
-                }
-                if(x<=Rectangles[i].x+0.75&&x>=Rectangles[i].x-0.75)
-                {
-                    if(z-Rectangles[i].z<=0.75&&z-Rectangles[i].z>=0.5)
-                        z=Rectangles[i].z+0.75;
-                    else if(Rectangles[i].z-z<=0.75&&Rectangles[i].z-z>=0.5)
-                        z=Rectangles[i].z-0.75;
-                }
-            }
-        }
-        
+    int frames=0;
+    for(int i=0;i<nbenchsteps;i++)
+        frames+=benchscript[i].frames;
+    return frames;
+}
+
+void Benchbegin (unsigned int seed, bool vsync)
+{
+    for(int i=0;i<nbenchsteps;i++)
+        benchAddSegment(benchrun, benchscript[i].name, benchscript[i].frames, i>0);
+    benchAddInfo(benchrun, "seed", (long)seed);
+    benchAddInfo(benchrun, "field", jsonString("14x14"));
+    benchAddInfo(benchrun, "frames_per_tick", (long)benchticks);
+    benchAddInfo(benchrun, "renderer", jsonString((const char *)glGetString(GL_RENDERER)));
+    benchAddInfo(benchrun, "version", jsonString((const char *)glGetString(GL_VERSION)));
+    benchAddInfo(benchrun, "vsync", string(vsync ? "true" : "false"));
 }
-void Jump ()
+
+/* Camera for this frame of the script */
+void Benchframe ()
 {
-    if(space==1)
-        {
-            if(y<2.8 && st1==0)
-            {
-                y+=0.1;
-                st1=0;
-            }
-            else if(y>2)
-            {
-                st1=1;
-                y-=0.1;
-            }
-            if(y>2 && st1==0)
-            {
-                y+=0.1;
-                st1=0;
-            }
-            else if(y>2)
-            {
-                st1=1;
-                y-=0.1;
-            }
-            if(y<=2 && st1==1)
-            {
-                space=0;
-                st1=0;
-            }
+    const Benchstep &step=benchscript[benchstep];
+    if(view!=step.view)
+        Pushinput (INPUT_VIEW, step.view);
+    view=step.view;
+    zoom=step.zoom_from+(step.zoom_to-step.zoom_from)*benchstepframe/step.frames;
+}
 
-        }
-        
+bool Benchtick ()
+{
+    return benchframes%benchticks==0;
 }
-void Pitfall ()
+
+/* Arrow keys towards the next cell of the goal field, stopping two tiles
+   short of the goal so the run never ends in Win(). The player lines up
+   with the middle of its cell before turning so it never cuts a corner
+   into a pit. Over the helicopter the cursor circles the field. */
+void Benchinput ()
 {
-    if(space==0 && (((x>=1.75)&&(x<=2.25)) && ((z>=-1.25)&&(z<=-0.75)))||(((x>=-0.25)&&(x<=0.25)) && ((z>=0.75)&&(z<=1.25)))||(((x>=-3.25)&&(x<=-2.75)) && ((z>=2.75)&&(z<=3.25)))||(((x>=-2.25)&&(x<=-1.75)) && ((z>=4.75)&&(z<=5.25)))||(((x>=3.75)&&(x<=4.25)) && ((z>=-4.25)&&(z<=-3.75)))||(((x>=-2.25)&&(x<=-1.75)) && ((z>=-1.25)&&(z<=-0.75))))
+    const Benchstep &step=benchscript[benchstep];
+    static int keys=0;
+    state1=state2=state3=state4=0;
+    int cell=worldToCell(grid, x, z);
+    if(step.walk&&cell!=-1&&fieldDistance(goalfield, cell)>2&&fieldDistance(goalfield, cell)<FIELD_UNREACHABLE)
+    {
+        int next=fieldStep(goalfield, cell);
+        float cx=grid.origin_x+cellX(grid, cell), cz=grid.origin_z+cellZ(grid, cell);
+        float nx=grid.origin_x+cellX(grid, next), nz=grid.origin_z+cellZ(grid, next);
+        if(nx!=cx)
         {
-            y-=0.5;
-            space=0;
+            if(fabs(z-cz)>0.05)
+                (z<cz ? state2 : state1)=1;
+            else
+                (nx>x ? state4 : state3)=1;
         }
-        //else if(space==0)
-        //    y=2;
-        if(y<=0)
+        else
         {
-            glfwTerminate();
-            exit(EXIT_SUCCESS);            
+            if(fabs(x-cx)>0.05)
+                (x<cx ? state4 : state3)=1;
+            else
+                (nz>z ? state2 : state1)=1;
         }
+    }
+    // A change of keys is timed like a key press made at this tick
+    if(keys!=(state1|state2<<1|state3<<2|state4<<3))
+        latencyInput ();
+    keys=state1|state2<<1|state3<<2|state4<<3;
+    if(step.view==5)
+    {
+        float a=2*M_PI*benchstepframe/step.frames;
+        xpos=30*cos(a);
+        ypos=20*sin(a);
+    }
+}
+
+/* Store the frame's time; false once the script is over */
+bool Benchrecord (double ms)
+{
+    benchRecordFrame(benchrun, benchstep, ms);
+    benchframes++;
+    if(++benchstepframe<benchscript[benchstep].frames)
+        return true;
+    benchstepframe=0;
+    if(++benchstep<nbenchsteps)
+        return true;
+    memLoopEnd ();
+    if(writeBenchJson(benchrun, benchpath))
+        cout<<"Wrote benchmark results to "<<benchpath<<endl;
+    return false;
 }
-void Win ()
+
+/* One sim tick: take the input, run the tick functions in order and
+   publish what draw() needs */
+void Simtick ()
 {
-    if(x>=6&&z<=-7)
+    PROFILE_SCOPE(PHASE_TICK);
+    hudTick ();
+    Takeinput ();
+    if (benchpath)
+        Benchinput ();
+    unsigned long inputs = latencyTick ();
+    {
+        PROFILE_SCOPE(PHASE_OBSTACLEBLOCK);
+        Obstacleblock ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_MOVINGPILESBLOCK);
+        Movingpilesblock ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_JUMP);
+        Jump ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_PITFALL);
+        Pitfall ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_WIN);
+        Win ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_BOUNDARY);
+        Boundary ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_PILESMOTION);
+        Pilesmotion ();
+    }
+
+    {
+        PROFILE_SCOPE(PHASE_PLAYER);
+        if(simview==2)
+            playerheaddir ();
+        else if(simview==1)
+            playeradventure ();
+        else if(simview==5)
         {
-            cout<<"Game Won\n";
-            glfwTerminate();
-            exit(EXIT_SUCCESS);   
+            playerheaddir ();
+            helicopterview ();
         }
+        else
+            playerheaddir ();
+    }
+
+    static long ticks = 0;
+    SimSnapshot &s=snapshots.writeSlot();
+    Takesnapshot (s);
+    s.tick=++ticks;
+    s.inputs=inputs;
+    snapshots.publish();
 }
-void Boundary ()
+
+/* The sim thread: a tick every 65 ms until the game ends. A tick that
+   runs late is not made up for by running the next ones early. */
+void Simloop ()
 {
-    if(z<=-7.25)
-        z=-7.25;
-    if(z>=6.25)
-        z=6.25;
-    if(x<=-7.25)
-        x=-7.25;
-    if(x>=6.25)
-        x=6.25;
+    const chrono::milliseconds period(65);
+    chrono::steady_clock::time_point next=chrono::steady_clock::now();
+    while(simrunning&&!gameover)
+    {
+        next+=period;
+        chrono::steady_clock::time_point now=chrono::steady_clock::now();
+        if(now>next)
+            next=now;
+        this_thread::sleep_until(next);
+        Simtick ();
+    }
 }
-void Pilesmotion ()
+
+/* Mouse position mapped onto the helicopter camera's plane */
+void Readcursor (GLFWwindow* window, int width, int height)
 {
-    for (int i = 0; i < 200; i++)
-        {
-            if(a[i]==1)
-            {
-                if(Rectangles[i].y<0.5 && st==0)
-                {
-                    Rectangles[i].y+=0.05;
-                    st=0;
-                }
-                else if(Rectangles[i].y>-0.5)
-                {
-                    st=1;
-                    Rectangles[i].y-=0.05;
-                }
-                if(Rectangles[i].y>-0.5 && st==0)
-                {
-                    Rectangles[i].y+=0.05;
-                    st=0;
-                }
-                else if(Rectangles[i].y>-0.5)
-                {
-                    st=1;
-                    Rectangles[i].y-=0.05;
-                }
-                if(Rectangles[i].y<=-0.5)
-                    st=0;
-            }
-        }
+    glfwGetCursorPos (window, &xpos, &ypos);
+    xpos=-77+(float)154.0/width*xpos;
+
+    ypos=-40+(float)80.0/height*ypos;
+
+    ypos*=-1;
 }
+
 int main (int argc, char** argv)
 {
+    long long launched = profileNow();
 	int width = 1600;
 	int height = 900;
     
@@ -1342,92 +1789,147 @@ int main (int argc, char** argv)
     
     //double xpos,ypos;
 
-    GLFWwindow* window = initGLFW(width, height);
+    // --trace <file> records a timeline of the run as Chrome trace JSON,
+    // --bench <file> runs the benchmark script and writes its frame times,
+    // --seed <n> picks the level, --memcheck fails the run if the frame
+    // loop allocates, --capture <file> writes every frame to a file,
+    // --shaders <dir> loads the shaders from <dir> instead of the built-in ones
+    unsigned int seed = 1;
+    const char *capturepath = NULL;
+    for (int i=1; i<argc; i++)
+        if (string(argv[i]) == "--memcheck")
+            memcheck = true;
+    for (int i=1; i+1<argc; i++)
+        if (string(argv[i]) == "--trace")
+            traceStart(argv[i+1]);
+        else if (string(argv[i]) == "--bench")
+            benchpath = argv[i+1];
+        else if (string(argv[i]) == "--seed")
+            seed = strtoul(argv[i+1], NULL, 10);
+        else if (string(argv[i]) == "--capture")
+            capturepath = argv[i+1];
+        else if (string(argv[i]) == "--shaders")
+            shaderdir = argv[i+1];
+    srand(seed);
+
+    // A wrong --shaders directory stops the game here, not with a blank
+    // screen once the loader gets to it
+    string source;
+    if (shaderdir && (!Shadersource ("Sample_GL.vert", source) || !Shadersource ("Sample_GL.frag", source)))
+        exit(EXIT_FAILURE);
 
-    for(int i=0;i<200;i++)
-    {
-        if((rand () % 10)==0)
-        {
-            if(i!=13&&i!=151)
-                a[i]=1;
+#ifdef HEADLESS
+    // --frames <n> sets how many frames to render before exiting
+    long frames = benchpath ? Benchlength() : 600;
+    for (int i=1; i+1<argc; i++)
+        if (string(argv[i]) == "--frames" && !benchpath)
+            frames = atol(argv[i+1]);
+    GLFWwindow* window = initHeadless(width, height, frames);
+#else
+    GLFWwindow* window = initGLFW(width, height);
+#endif
+    gamewindow = window;
+
+    // Load on a thread of its own with a hidden window's context, showing
+    // the loading screen meanwhile. Benchmarks just wait, so every run
+    // renders the same frames.
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    loadercontext = glfwCreateWindow(1, 1, "", NULL, window);
+    if (!loadercontext) {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    loaderthread = thread(Loadassets);
+    long loadingframes = 0;
+    double firstframe = 0;
+    while (!loaded.load(memory_order_acquire)) {
+        if (benchpath || glfwWindowShouldClose(window)) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
         }
-        else if(rand () % 15==0)
-        {
-            if(i!=13&&i!=151)
-                b[i]=1;
+        Drawloading (window);
+        glfwSwapBuffers(window);
+        if (!loadingframes++)
+            firstframe = (profileNow() - launched)/1e6;
+        glfwPollEvents();
+    }
+    if (loadingframes)
+        printf("Loading screen up after %.1f ms, %ld frames shown while loading\n", firstframe, loadingframes);
+
+    initGL (window, width, height);
+    printf("Ready to play after %.1f ms\n", (profileNow() - launched)/1e6);
+    if (capturepath) {
+        int fbwidth=width, fbheight=height;
+        glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+        if (!captureInit (capturepath, fbwidth, fbheight)) {
+            glfwTerminate();
+            exit(EXIT_FAILURE);
         }
     }
 
-	initGL (window, width, height);
+    if (benchpath) {
+        bool vsync = false;
+#ifndef HEADLESS
+        glfwSwapInterval(0);    // measure frames, not the display's refresh
+#endif
+        Benchbegin (seed, vsync);
+    }
+
+    // The level as it starts, for the first frame
+    Takesnapshot (snapshots.writeSlot());
+    snapshots.publish();
+
+    jobsInit ();
 
-    double last_update_time = glfwGetTime(), current_time;
+    // Benchmark runs tick on the frame count, in step with the frames, so
+    // they keep the sim on this thread
+    if (!benchpath) {
+        simrunning = true;
+        simthread = thread(Simloop);
+    }
 
         /* Draw in loop */
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !gameover) {
+        PROFILE_SCOPE(PHASE_FRAME);
+        glCountFrame();
+        memFrame();
+        long long framestart = profileNow();
+        if (benchpath)
+            Benchframe ();
+        else
+            Readcursor (window, width, height);
+        if (view == 5)
+            glfwSetScrollCallback (window, scroll);
 
         // OpenGL Draw commands
-        draw();
+        {
+            PROFILE_SCOPE(PHASE_DRAW);
+            const SimSnapshot &sim = snapshots.read();
+            if (sim.level != drawnlevel)
+                Showlevel (sim.level);
+            latencyFrame (sim.inputs);
+            draw(sim);
+        }
+        captureFrame ();
 
         // Swap Frame Buffer in double buffering
-        glfwSwapBuffers(window);
+        {
+            PROFILE_SCOPE(PHASE_SWAP);
+            glfwSwapBuffers(window);
+            latencyPresent ();
+        }
 
         // Poll for Keyboard and mouse events
-        glfwPollEvents();
-
-        
-
-        // Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-        current_time = glfwGetTime(); // Time in seconds
-        if ((current_time - last_update_time) >= 0.065) { // atleast 0.5s elapsed since last frame
-            // do something every 0.5 seconds ..
-        
-        glfwGetCursorPos (window, &xpos, &ypos);
-        xpos=-77+(float)154.0/width*xpos;
-
-        ypos=-40+(float)80.0/height*ypos;
-
-        ypos*=-1;
-
-        //float x = -70.0;
-
-        //float y = -5.0;
-        Obstacleblock ();
-
-        Movingpilesblock ();
-
-        Jump ();
-
-        Pitfall ();
-
-        Win ();
-        
-        Boundary ();
-
-        Pilesmotion ();
-        //cannon_rotation = atan2 (ypos-y,xpos-x) * 180 / M_PI;
-        if(view==2)
-            playerheaddir ();
-        else if(view==1)
-            playeradventure ();
-        else if(view==5)
         {
-            playerheaddir ();
-            helicopterview ();
-            glfwSetScrollCallback (window, scroll);
-        }
-        else
-            playerheaddir ();
-        
-        
-        
-          //cout<<x<<" "<<z<<endl;
-        
-        
-        
-            last_update_time = current_time;
+            PROFILE_SCOPE(PHASE_POLL);
+            glfwPollEvents();
         }
+
+        if (benchpath && Benchtick ())
+            Simtick ();
+        if (benchpath && !Benchrecord ((profileNow() - framestart)/1e6))
+            break;
     }
 
-    glfwTerminate();
-    exit(EXIT_SUCCESS);
+    Exitgame ();
 }
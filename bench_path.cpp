@@ -0,0 +1,298 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "maze.h"
+#include "pathfinding.h"
+#include "flowfield.h"
+#include "hpa.h"
+#include "levelgen.h"
+
+using namespace std;
+
+/* Benchmark of the grid searches on generated fields of growing size.
+   Usage: bench_path [max_side] [queries]  */
+
+typedef bool (*PathFunction) (const Grid&, int, int, vector<int>&, PathStats*);
+
+struct Search {
+    const char* name;
+    PathFunction find;
+};
+
+static const Search searches[] = {
+    {"bfs", findPathBFS},
+    {"astar", findPathAStar},
+    {"jps", findPathJPS},
+};
+
+static int randomWalkable (const Grid& grid, mt19937& rng)
+{
+    for (;;) {
+        int cell = rng() % grid.tiles.size();
+        if (isWalkable(grid, cell))
+            return cell;
+    }
+}
+
+static void runField (const char* kind, const Grid& grid, int queries, unsigned int seed)
+{
+    mt19937 rng(seed);
+    vector<int> starts(queries), goals(queries);
+    for (int q=0; q<queries; q++) {
+        starts[q] = randomWalkable(grid, rng);
+        goals[q] = randomWalkable(grid, rng);
+    }
+
+    vector<int> reference(queries), path;
+    for (size_t s=0; s<sizeof(searches)/sizeof(searches[0]); s++) {
+        long expanded = 0, touched = 0;
+        int found = 0;
+        PathStats stats;
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for (int q=0; q<queries; q++) {
+            bool ok = searches[s].find(grid, starts[q], goals[q], path, &stats);
+            expanded += stats.expanded;
+            touched += stats.touched;
+            found += ok;
+            // Every search must agree with BFS on the shortest length
+            if (s == 0)
+                reference[q] = pathLength(path);
+            else if (pathLength(path) != reference[q]) {
+                fprintf(stderr, "%s: length %d, expected %d (%s %dx%d query %d)\n",
+                        searches[s].name, pathLength(path), reference[q], kind, grid.width, grid.height, q);
+                exit(EXIT_FAILURE);
+            }
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        printf("%-8s %5dx%-5d %-6s %9.3f ms/query %12ld expanded %12ld touched %4d/%d found\n",
+               kind, grid.width, grid.height, searches[s].name, ms/queries,
+               expanded/queries, touched/queries, found, queries);
+    }
+}
+
+/* Goal distance field: one build, then per-agent steps are lookups and tile
+   changes are repaired locally */
+static void runDistanceField (const char* kind, Grid grid, int agents, unsigned int seed)
+{
+    mt19937 rng(seed);
+    int goal = randomWalkable(grid, rng);
+    DistanceField field;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    buildDistanceField(field, grid, goal);
+    double build_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    // Walk every agent all the way home one lookup at a time
+    long steps = 0;
+    begin = chrono::steady_clock::now();
+    for (int a=0; a<agents; a++)
+        for (int cell = randomWalkable(grid, rng); fieldStep(field, cell) != -1; cell = fieldStep(field, cell))
+            steps++;
+    double walk_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+
+    // Toggle random tiles, repairing after each
+    const int toggles = 200;
+    begin = chrono::steady_clock::now();
+    for (int i=0; i<toggles; i++) {
+        int cell = rng() % grid.tiles.size();
+        grid.tiles[cell] = isWalkable(grid, cell) ? TILE_OBSTACLE : TILE_FLOOR;
+        repairDistanceField(field, grid, cell);
+    }
+    double repair_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    DistanceField rebuilt;
+    buildDistanceField(rebuilt, grid, goal);
+    if (rebuilt.dist != field.dist) {
+        fprintf(stderr, "field: repaired distances differ from a rebuild (%s %dx%d)\n", kind, grid.width, grid.height);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-8s %5dx%-5d field  %9.3f ms build %9.3f ns/step %9.4f ms/repair\n",
+           kind, grid.width, grid.height, build_ms, steps ? walk_ns/steps : 0.0, repair_ms/toggles);
+}
+
+/* Paths must step between neighbouring walkable cells */
+static bool validPath (const Grid& grid, int start, int goal, const vector<int>& path)
+{
+    if (path.empty() || path.front() != start || path.back() != goal)
+        return false;
+    for (size_t i=0; i<path.size(); i++) {
+        if (!isWalkable(grid, path[i]))
+            return false;
+        if (i > 0 && abs(cellX(grid, path[i]) - cellX(grid, path[i-1])) + abs(cellZ(grid, path[i]) - cellZ(grid, path[i-1])) != 1)
+            return false;
+    }
+    return true;
+}
+
+/* Chunked abstraction: build once, long queries against JPS as reference */
+static void runHpa (const char* kind, Grid grid, int queries, unsigned int seed)
+{
+    mt19937 rng(seed);
+    HpaGraph graph;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    buildHpaGraph(graph, grid);
+    double build_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    double hpa_ms = 0, jps_ms = 0, excess = 0;
+    int found = 0;
+    vector<int> path, reference;
+    for (int q=0; q<queries; q++) {
+        int start = randomWalkable(grid, rng), goal = randomWalkable(grid, rng);
+        begin = chrono::steady_clock::now();
+        bool ok = findPathHPA(graph, grid, start, goal, path);
+        hpa_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        begin = chrono::steady_clock::now();
+        bool ok_ref = findPathJPS(grid, start, goal, reference);
+        jps_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        if (ok != ok_ref || (ok && !validPath(grid, start, goal, path))) {
+            fprintf(stderr, "hpa: bad path (%s %dx%d query %d)\n", kind, grid.width, grid.height, q);
+            exit(EXIT_FAILURE);
+        }
+        if (ok && pathLength(reference) > 0) {
+            excess += (double)pathLength(path)/pathLength(reference) - 1;
+            found++;
+        }
+    }
+
+    // Tile changes only rebuild the chunks they touch
+    const int toggles = 100;
+    begin = chrono::steady_clock::now();
+    for (int i=0; i<toggles; i++) {
+        int cell = rng() % grid.tiles.size();
+        grid.tiles[cell] = isWalkable(grid, cell) ? TILE_OBSTACLE : TILE_FLOOR;
+        repairHpaGraph(graph, grid, cell);
+    }
+    double repair_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    HpaGraph rebuilt;
+    buildHpaGraph(rebuilt, grid, graph.chunk);
+    for (size_t c=0; c<rebuilt.chunks.size(); c++)
+        if (rebuilt.chunks[c].cells != graph.chunks[c].cells || rebuilt.chunks[c].dist != graph.chunks[c].dist ||
+            rebuilt.chunks[c].route != graph.chunks[c].route || rebuilt.chunks[c].steps != graph.chunks[c].steps ||
+            rebuilt.chunks[c].hops != graph.chunks[c].hops || rebuilt.chunks[c].hopstart != graph.chunks[c].hopstart) {
+            fprintf(stderr, "hpa: repaired chunk %zu differs from a rebuild (%s %dx%d)\n", c, kind, grid.width, grid.height);
+            exit(EXIT_FAILURE);
+        }
+
+    printf("%-8s %5dx%-5d hpa    %9.1f ms build %9.3f ms/query (jps %9.3f) %6.2f%% longer %8.3f ms/repair\n",
+           kind, grid.width, grid.height, build_ms, hpa_ms/queries, jps_ms/queries,
+           found ? 100*excess/found : 0.0, repair_ms/toggles);
+}
+
+/* Random pits and obstacles anywhere on the field, start and goal opened
+   at opposite corners */
+static vector<HazardCandidate> randomHazards (Grid& grid, int count, mt19937& rng, int& start, int& goal)
+{
+    start = cellIndex(grid, 0, 0);
+    goal = cellIndex(grid, grid.width - 1, grid.height - 1);
+    grid.tiles[start] = grid.tiles[goal] = TILE_FLOOR;
+    vector<HazardCandidate> candidates(count);
+    for (int i=0; i<count; i++) {
+        candidates[i].cell = rng() % grid.tiles.size();
+        candidates[i].tile = rng() % 2 ? TILE_PIT : TILE_OBSTACLE;
+    }
+    return candidates;
+}
+
+/* Replays placeHazards() one candidate at a time on small fields: with the
+   hazards accepted so far in place, one on an end must be rejected, one on
+   a blocked cell accepted, and one on an open cell accepted if and only if
+   the goal stays reachable */
+static void checkHazards (int side, int count, unsigned int seed)
+{
+    mt19937 rng(seed);
+    Grid grid;
+    generateScatter(grid, side, side, seed, 0.2f);
+    int start, goal;
+    vector<HazardCandidate> candidates = randomHazards(grid, count, rng, start, goal);
+    Grid placed = grid;
+    vector<char> accepted;
+    placeHazards(placed, start, goal, candidates, &accepted);
+
+    vector<int> path;
+    for (int i=0; i<count; i++) {
+        int cell = candidates[i].cell;
+        if (cell == start || cell == goal) {
+            if (accepted[i]) {
+                fprintf(stderr, "hazards: candidate %d blocks an end (%dx%d seed %u)\n", i, side, side, seed);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        if (!isWalkable(grid, cell)) {
+            if (!accepted[i]) {
+                fprintf(stderr, "hazards: candidate %d rejected on a blocked cell (%dx%d seed %u)\n", i, side, side, seed);
+                exit(EXIT_FAILURE);
+            }
+            grid.tiles[cell] = candidates[i].tile;
+            continue;
+        }
+        unsigned char open = grid.tiles[cell];
+        grid.tiles[cell] = candidates[i].tile;
+        bool still = findPathBFS(grid, start, goal, path);
+        if (accepted[i] != (char)still) {
+            fprintf(stderr, "hazards: candidate %d %s but the goal %s reachable (%dx%d seed %u)\n", i,
+                    accepted[i] ? "accepted" : "rejected", still ? "stays" : "is not", side, side, seed);
+            exit(EXIT_FAILURE);
+        }
+        if (!accepted[i])
+            grid.tiles[cell] = open;
+    }
+    if (grid.tiles != placed.tiles) {
+        fprintf(stderr, "hazards: placed field differs from the replay (%dx%d seed %u)\n", side, side, seed);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Hazard placement at level generator scale */
+static void runHazards (int side, int count, unsigned int seed)
+{
+    mt19937 rng(seed);
+    Grid grid;
+    generateScatter(grid, side, side, seed, 0.2f);
+    int start, goal;
+    vector<HazardCandidate> candidates = randomHazards(grid, count, rng, start, goal);
+    vector<int> path;
+    bool reachable = findPathBFS(grid, start, goal, path);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    int placed = placeHazards(grid, start, goal, candidates);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+
+    if (reachable && !findPathBFS(grid, start, goal, path)) {
+        fprintf(stderr, "hazards: goal cut off (%dx%d)\n", side, side);
+        exit(EXIT_FAILURE);
+    }
+    printf("hazards  %5dx%-5d place  %9.1f ms %9.3f us/candidate %8d/%d placed\n",
+           side, side, ms, 1000*ms/count, placed, count);
+}
+
+int main (int argc, char** argv)
+{
+    int max_side = argc > 1 ? atoi(argv[1]) : 4096;
+    int queries = argc > 2 ? atoi(argv[2]) : 20;
+
+    Grid grid;
+    for (int side = 64; side <= max_side; side *= 2) {
+        // Fewer queries on the multi-million cell fields
+        int count = side >= 1024 ? max(1, queries/4) : queries;
+        generateMaze(grid, side+1, side+1, side, 0.1f);
+        runField("maze", grid, count, side);
+        runDistanceField("maze", grid, 100, side);
+        runHpa("maze", grid, count, side);
+        generateScatter(grid, side, side, side, 0.3f);
+        runField("scatter", grid, count, side);
+        runDistanceField("scatter", grid, 100, side);
+        runHpa("scatter", grid, count, side);
+    }
+
+    for (unsigned int seed=1; seed<=20; seed++)
+        checkHazards(24, 400, seed);
+    // A million candidates on a 2000x2000 field at the full size
+    int hazard_side = min(max_side, 2000);
+    runHazards(hazard_side, hazard_side*hazard_side/4, hazard_side);
+    return 0;
+}
@@ -0,0 +1,386 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+#include "maze.h"
+#include "pathfinding.h"
+#include "flowfield.h"
+#include "piles.h"
+#include "jobs.h"
+#include "drawlist.h"
+#include "timerwheel.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+/* Microbenchmarks of the functions run on every sim tick, of recording
+   draw lists, and of level generation and pathfinding, at several entity counts and grid sizes.
+   Usage: bench_sim [--save file] [--baseline file]
+   --save writes the results as a baseline; --baseline compares against one. */
+
+void Exitgame ()
+{
+    fprintf(stderr, "bench_sim: the game ended during a benchmark\n");
+    exit(EXIT_FAILURE);
+}
+
+bool Nextlevel ()
+{
+    fprintf(stderr, "bench_sim: a level was won during a benchmark\n");
+    exit(EXIT_FAILURE);
+}
+
+struct Result {
+    string name;
+    int size;
+    double ns;
+};
+static vector<Result> results;
+
+/* Nanoseconds per call of 'op': batches double until one takes 20 ms,
+   then the best of five such batches counts */
+template <class Op>
+static double measure (Op op)
+{
+    long n = 1;
+    for (;;) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for (long i=0; i<n; i++)
+            op();
+        if (chrono::steady_clock::now() - begin >= chrono::milliseconds(20))
+            break;
+        n *= 2;
+    }
+    double best = 1e300;
+    for (int r=0; r<5; r++) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for (long i=0; i<n; i++)
+            op();
+        best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count()/n);
+    }
+    return best;
+}
+
+static void report (const char* name, int size, double ns, bool per_tick=false)
+{
+    Result r = {name, size, ns};
+    results.push_back(r);
+    printf("%-20s %7d %12.1f ns/op", name, size, ns);
+    if (per_tick)
+        printf(" %12.0f ticks/s", 1e9/ns);
+    printf("\n");
+}
+
+/* 'n' tiles laid out row by row around the origin, every 10th a pile and
+   every 15th an obstacle, like the odds Generatelevel() rolls with. The
+   piles start out raised. */
+static void layoutField (int n)
+{
+    int side = (int)ceil(sqrt((double)n));
+    initGrid(grid, side, side, -side/2, -side/2);
+    ntiles = n;
+    for (int i=0; i<n; i++) {
+        Rectangles[i].x = grid.origin_x + i % side;
+        Rectangles[i].z = grid.origin_z + i / side;
+        a[i] = i % 10 == 5;
+        b[i] = i % 15 == 7;
+        Rectangles[i].y = 0;
+        Obstacles[i].x = Rectangles[i].x;
+        Obstacles[i].z = Rectangles[i].z;
+        Obstacles[i].y = 0.5f;
+        if (i % 23 == 11)
+            grid.tiles[i] = TILE_PIT;
+    }
+    piletick = 4;
+    Startpiles();
+}
+
+/* Player positions spread over the field, clear of the goal corner so
+   Win() never fires */
+static vector<float> positions (int count, unsigned int seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> coord(-7.25f, 6.25f);
+    vector<float> xz;
+    while ((int)xz.size() < 2*count) {
+        float px = coord(rng), pz = coord(rng);
+        if (px >= 5.5f && pz <= -6.5f)
+            continue;
+        xz.push_back(px);
+        xz.push_back(pz);
+    }
+    return xz;
+}
+
+static void benchTick ()
+{
+    const int counts[] = {50, 200, 500};
+    vector<float> xz = positions(1024, 1);
+    for (int c=0; c<3; c++) {
+        int n = counts[c];
+        layoutField(n);
+        size_t k = 0;
+        // The player is put back at a new spot before each call so the
+        // blocking tests do the same mix of hits and misses every run
+        report("Obstacleblock", n, measure([&] {
+            x = xz[k]; z = xz[k+1]; space = 0;
+            k = (k + 2) % xz.size();
+            Obstacleblock();
+        }));
+        report("Movingpilesblock", n, measure([&] {
+            x = xz[k]; z = xz[k+1]; space = 0;
+            k = (k + 2) % xz.size();
+            Movingpilesblock();
+        }));
+        report("Pilesmotion", n, measure([&] { Pilesmotion(); }));
+        report("Pitfall", n, measure([&] {
+            x = xz[k]; z = xz[k+1]; y = 2; space = 0;
+            k = (k + 2) % xz.size();
+            Pitfall();
+        }));
+        // Everything main() runs in one tick, in the same order
+        report("tick", n, measure([&] {
+            x = xz[k]; z = xz[k+1]; y = 2;
+            k = (k + 2) % xz.size();
+            Obstacleblock();
+            Movingpilesblock();
+            Jump();
+            Pitfall();
+            Win();
+            Boundary();
+            Pilesmotion();
+            playerheaddir();
+        }), true);
+    }
+}
+
+/* Draw lists of fields of each size, seen from above like view 4, so
+   some of the larger fields are culled */
+static void benchDraws ()
+{
+    const int counts[] = {50, 200, 500};
+    static Level level;
+    static SimSnapshot sim;
+    static FrameDraws draws;
+    glm::mat4 VP = glm::ortho(-16.0f, 16.0f, -9.0f, 9.0f, 0.1f, 500.0f) *
+                   glm::lookAt(glm::vec3(0,10,0), glm::vec3(0,0,0), glm::vec3(0,0,-1));
+    for (int c=0; c<3; c++) {
+        int n = counts[c];
+        layoutField(n);
+        for (int i=0; i<n; i++) {
+            level.tiles[i] = Rectangles[i];
+            level.obstacles[i] = Obstacles[i];
+            level.b[i] = b[i];
+        }
+        level.ntiles = n;
+        Takesnapshot(sim);
+        sim.level = &level;
+        report("recordDraws", n, measure([&] { recordDraws(draws, sim, VP); }));
+    }
+}
+
+/* Hazards that each change state every 10 to 1000 ticks: checked every
+   tick, against sleeping on a timer wheel until their change is due */
+static long hazardchanges = 0;
+static vector<long> hazarddue;
+static TimerWheel hazards;
+
+static long hazardPeriod (int i, long tick)
+{
+    return 10 + (i*7919 + tick) % 991;
+}
+
+static void hazardChange (int i, long tick)
+{
+    hazardchanges++;
+    timerSchedule(hazards, tick + hazardPeriod(i, tick), hazardChange, i);
+}
+
+static void benchHazards ()
+{
+    const int counts[] = {1000, 10000, 100000};
+    for (int c=0; c<3; c++) {
+        int n = counts[c];
+        hazarddue.assign(n, 0);
+        for (int i=0; i<n; i++)
+            hazarddue[i] = hazardPeriod(i, 0);
+        long tick = 0;
+        report("hazards polled", n, measure([&] {
+            tick++;
+            for (int i=0; i<n; i++)
+                if (hazarddue[i] == tick) {
+                    hazardchanges++;
+                    hazarddue[i] = tick + hazardPeriod(i, tick);
+                }
+        }), true);
+
+        timerInit(hazards, n, 0);
+        for (int i=0; i<n; i++)
+            timerSchedule(hazards, hazardPeriod(i, 0), hazardChange, i);
+        tick = 0;
+        report("hazards on wheel", n, measure([&] { timerAdvance(hazards, ++tick); }), true);
+    }
+}
+
+static void benchLevels ()
+{
+    srand(1);
+    static Level level;
+    report("Generatelevel", 14, measure([] { Generatelevel(level, true); }));
+    const int sides[] = {64, 256, 1024};
+    Grid maze;
+    unsigned int seed = 0;
+    for (int s=0; s<3; s++) {
+        int side = sides[s] + 1;
+        report("generateMaze", side, measure([&] { generateMaze(maze, side, side, seed++, 0.1f); }));
+    }
+}
+
+static void benchPaths ()
+{
+    const int sides[] = {64, 256, 1024};
+    Grid maze;
+    vector<int> path;
+    for (int s=0; s<3; s++) {
+        int side = sides[s] + 1;
+        generateMaze(maze, side, side, side, 0.1f);
+        mt19937 rng(side);
+        vector<int> ends;
+        while (ends.size() < 64) {
+            int cell = rng() % maze.tiles.size();
+            if (isWalkable(maze, cell))
+                ends.push_back(cell);
+        }
+        size_t k = 0;
+        report("findPathAStar", side, measure([&] {
+            findPathAStar(maze, ends[k], ends[k+1], path);
+            k = (k + 2) % ends.size();
+        }));
+        report("findPathJPS", side, measure([&] {
+            findPathJPS(maze, ends[k], ends[k+1], path);
+            k = (k + 2) % ends.size();
+        }));
+        // The same 32 queries one after another, then as jobs
+        vector<PathQuery> queries;
+        for (size_t i=0; i<ends.size(); i+=2) {
+            PathQuery q = {ends[i], ends[i+1]};
+            queries.push_back(q);
+        }
+        vector<vector<int> > paths;
+        report("findPathJPS x32", side, measure([&] {
+            for (size_t i=0; i<queries.size(); i++)
+                findPathJPS(maze, queries[i].start, queries[i].goal, path);
+        }));
+        report("findPathsJPS x32", side, measure([&] { findPathsJPS(maze, queries, paths); }));
+        DistanceField field;
+        report("buildDistanceField", side, measure([&] {
+            buildDistanceField(field, maze, ends[k]);
+            k = (k + 1) % ends.size();
+        }));
+    }
+
+    // The hint route on the game's own field, planned around the piles
+    srand(1);
+    Generatelevel(true);
+    int from = worldToCell(grid, -7, 6), goal = worldToCell(grid, 6, -7);
+    vector<TimedStep> route;
+    long tick = 0;
+    report("findPathSpaceTime", 14, measure([&] {
+        findPathSpaceTime(grid, from, goal, tick++ % PILE_PERIOD, 10, 5000, route);
+    }));
+}
+
+/* One tab-separated line per result: name, size, ns. Names may hold
+   spaces, so the fields are split on tabs, not on whitespace. */
+static bool saveBaseline (const char* path)
+{
+    ofstream out(path);
+    for (size_t i=0; i<results.size(); i++)
+        out<<results[i].name<<"\t"<<results[i].size<<"\t"<<results[i].ns<<"\n";
+    return (bool)out;
+}
+
+/* Ratio against the baseline; more than 10% either way is called out */
+static void compareBaseline (const char* path)
+{
+    ifstream in(path);
+    if (!in) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    map<pair<string, int>, double> baseline;
+    string line;
+    for (int n=1; getline(in, line); n++) {
+        size_t tab = line.find('\t');
+        int size;
+        double ns;
+        istringstream fields(tab == string::npos ? "" : line.substr(tab + 1));
+        if (!(fields>>size>>ns)) {
+            fprintf(stderr, "%s:%d: not a baseline line, skipped\n", path, n);
+            continue;
+        }
+        baseline[make_pair(line.substr(0, tab), size)] = ns;
+    }
+
+    int slower = 0, compared = 0;
+    vector<size_t> missing;
+    printf("\n%-20s %7s %12s %12s %8s\n", "vs baseline", "size", "before", "now", "change");
+    for (size_t i=0; i<results.size(); i++) {
+        map<pair<string, int>, double>::iterator it = baseline.find(make_pair(results[i].name, results[i].size));
+        if (it == baseline.end()) {
+            missing.push_back(i);
+            continue;
+        }
+        compared++;
+        double change = 100*(results[i].ns/it->second - 1);
+        const char* mark = change > 10 ? "  slower" : change < -10 ? "  faster" : "";
+        slower += change > 10;
+        printf("%-20s %7d %12.1f %12.1f %+7.1f%%%s\n", results[i].name.c_str(), results[i].size,
+               it->second, results[i].ns, change, mark);
+    }
+    printf("%d of %d benchmarks compared more than 10%% slower\n", slower, compared);
+    if (!missing.empty()) {
+        printf("%zu not in the baseline:", missing.size());
+        for (size_t i=0; i<missing.size(); i++)
+            printf("%s %s/%d", i ? "," : "", results[missing[i]].name.c_str(), results[missing[i]].size);
+        printf("\n");
+    }
+}
+
+int main (int argc, char** argv)
+{
+    const char *save = NULL, *baseline = NULL;
+    for (int i=1; i+1<argc; i++)
+        if (!strcmp(argv[i], "--save"))
+            save = argv[++i];
+        else if (!strcmp(argv[i], "--baseline"))
+            baseline = argv[++i];
+
+    jobsInit();
+    printf("%d job workers\n", jobWorkers());
+    benchTick();
+    benchDraws();
+    benchHazards();
+    benchLevels();
+    benchPaths();
+
+    if (save && !saveBaseline(save)) {
+        perror(save);
+        return EXIT_FAILURE;
+    }
+    if (baseline)
+        compareBaseline(baseline);
+    jobsShutdown();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "benchmark.h"
+
+using namespace std;
+
+void benchAddSegment (BenchRun& run, const char* name, int frames, bool counted)
+{
+    BenchSegment segment;
+    segment.name = name;
+    segment.counted = counted;
+    run.segments.push_back(segment);
+    // Reserved in place: copying a vector does not keep its capacity
+    run.segments.back().frame_ms.reserve(frames);
+}
+
+void benchAddInfo (BenchRun& run, const char* key, const string& value)
+{
+    run.info.push_back(make_pair(string(key), value));
+}
+
+void benchAddInfo (BenchRun& run, const char* key, long value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%ld", value);
+    benchAddInfo(run, key, string(buffer));
+}
+
+void benchRecordFrame (BenchRun& run, int segment, double ms)
+{
+    run.segments[segment].frame_ms.push_back(ms);
+}
+
+string jsonString (const string& text)
+{
+    string quoted = "\"";
+    for (size_t i=0; i<text.size(); i++) {
+        char c = text[i];
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if ((unsigned char)c < 0x20)
+            continue;
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void writeStats (FILE* out, const char* indent, vector<double> ms)
+{
+    sort(ms.begin(), ms.end());
+    double sum = 0;
+    for (size_t i=0; i<ms.size(); i++)
+        sum += ms[i];
+    fprintf(out, "%s\"frames\": %zu", indent, ms.size());
+    if (ms.empty())
+        return;
+    const int ranks[3] = {50, 95, 99};
+    fprintf(out, ",\n%s\"mean_ms\": %.4f", indent, sum/ms.size());
+    for (int r=0; r<3; r++) {
+        size_t rank = (ms.size()*ranks[r] + 99)/100;
+        fprintf(out, ",\n%s\"p%d_ms\": %.4f", indent, ranks[r], ms[rank ? rank - 1 : 0]);
+    }
+    fprintf(out, ",\n%s\"max_ms\": %.4f", indent, ms.back());
+}
+
+bool writeBenchJson (const BenchRun& run, const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    fprintf(out, "{\n");
+    for (size_t i=0; i<run.info.size(); i++)
+        fprintf(out, "  %s: %s,\n", jsonString(run.info[i].first).c_str(), run.info[i].second.c_str());
+
+    vector<double> all;
+    fprintf(out, "  \"segments\": [\n");
+    for (size_t s=0; s<run.segments.size(); s++) {
+        const BenchSegment& segment = run.segments[s];
+        fprintf(out, "    {\n      \"name\": %s,\n      \"counted\": %s,\n",
+                jsonString(segment.name).c_str(), segment.counted ? "true" : "false");
+        writeStats(out, "      ", segment.frame_ms);
+        fprintf(out, "\n    }%s\n", s+1 < run.segments.size() ? "," : "");
+        if (segment.counted)
+            all.insert(all.end(), segment.frame_ms.begin(), segment.frame_ms.end());
+    }
+    fprintf(out, "  ],\n  \"total\": {\n");
+    writeStats(out, "    ", all);
+    fprintf(out, "\n  }\n}\n");
+    fclose(out);
+    return true;
+}
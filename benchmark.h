@@ -0,0 +1,35 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+/* Frame times of a scripted benchmark run, grouped by the part of the
+   script they belong to. Storage is reserved up front so recording a
+   frame does not allocate. */
+struct BenchSegment {
+    std::string name;
+    bool counted;                   // false for warm-up, left out of the totals
+    std::vector<double> frame_ms;
+};
+typedef struct BenchSegment BenchSegment;
+
+struct BenchRun {
+    std::vector<BenchSegment> segments;
+    std::vector<std::pair<std::string, std::string> > info;    // extra top-level JSON fields, values already JSON
+};
+typedef struct BenchRun BenchRun;
+
+void benchAddSegment (BenchRun& run, const char* name, int frames, bool counted=true);
+void benchAddInfo (BenchRun& run, const char* key, const std::string& value);
+void benchAddInfo (BenchRun& run, const char* key, long value);
+void benchRecordFrame (BenchRun& run, int segment, double ms);
+
+/* Count, mean, p50/p95/p99 and max frame time per segment and over all
+   counted segments. Returns false if the file can not be written. */
+bool writeBenchJson (const BenchRun& run, const char* path);
+
+/* 'text' as a quoted JSON string */
+std::string jsonString (const std::string& text);
+
+#endif
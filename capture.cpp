@@ -0,0 +1,113 @@
+#include <glad/glad.h>
+
+#include "capture.h"
+#include "memtrack.h"
+#include "profiler.h"
+
+/* Three buffers: the frame being copied, the one before it still in
+   flight, and the one two frames back that is written out */
+const int CAPTURE_RING = 3;
+
+static GLuint buffers[CAPTURE_RING];
+static GLsync fences[CAPTURE_RING];
+static FILE* file = NULL;
+static const char* filename;
+static int width, height;
+static long bytes;
+static long issued = 0, written = 0;    // frames copied into buffers, and written out of them
+static long stalls = 0, failures = 0;
+static long long stalled = 0;           // ns waited on fences
+static long long started, finished;     // first copy issued, last frame written
+
+bool captureInit (const char* path, int w, int h)
+{
+    file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    filename = path;
+    width = w;
+    height = h;
+    bytes = (long)width*height*4;
+    MEM_SCOPE(MEM_CAPTURE);
+    glGenBuffers(CAPTURE_RING, buffers);
+    for (int i=0; i<CAPTURE_RING; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        memGpuBuffer(buffers[i], bytes);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    printf("Capturing %dx%d frames to %s\n", width, height, path);
+    return true;
+}
+
+/* Writes out the oldest frame in flight, first waiting for its copy if
+   the GPU has not got that far */
+static void writeOldest ()
+{
+    int slot = written % CAPTURE_RING;
+    if (glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+        long long start = profileNow();
+        while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        stalls++;
+        stalled += profileNow() - start;
+    }
+    glDeleteSync(fences[slot]);
+    fences[slot] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (!pixels || fwrite(pixels, bytes, 1, file) != 1)
+        failures++;
+    if (pixels)
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    written++;
+    finished = profileNow();
+}
+
+void captureFrame ()
+{
+    if (!file)
+        return;
+    PROFILE_SCOPE(PHASE_CAPTURE);
+    if (issued - written == CAPTURE_RING - 1)
+        writeOldest();
+
+    int slot = issued % CAPTURE_RING;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!issued++)
+        started = profileNow();
+}
+
+void captureFinish ()
+{
+    if (!file)
+        return;
+    while (written < issued)
+        writeOldest();
+    for (int i=0; i<CAPTURE_RING; i++)
+        memGpuFree(buffers[i]);
+    glDeleteBuffers(CAPTURE_RING, buffers);
+    if (fclose(file))
+        failures++;
+    file = NULL;
+}
+
+void captureReport (FILE* out)
+{
+    if (!written)
+        return;
+    double seconds = (finished - started)/1e9;
+    fprintf(out, "capture: %ld frames of %dx%d to %s, %.1f frames/s, %.1f MB/s\n", written, width, height,
+            filename, written/seconds, written*(bytes/1e6)/seconds);
+    fprintf(out, "capture: waited on %ld frames, %.3f ms in all\n", stalls, stalled/1e6);
+    if (failures)
+        fprintf(out, "capture: %ld frames could not be written\n", failures);
+}
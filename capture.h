@@ -0,0 +1,21 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdio>
+
+/* Frame capture that does not stall the renderer. Each frame is copied
+   into one of a ring of pixel buffer objects by glReadPixels, which with a
+   pack buffer bound only queues the copy, and a fence marks the copy's
+   end. Frame N is mapped and written out while frame N + 2 renders, by
+   which time the GPU is normally done with it; only when it is not does
+   captureFrame() wait on the fence, and that is counted as a stall.
+   Frames go to a file as raw RGBA video with the bottom row first, e.g.
+     ffmpeg -f rawvideo -pix_fmt rgba -s 1600x900 -i file -vf vflip out.mp4 */
+bool captureInit (const char* path, int width, int height);
+void captureFrame ();       // after draw(), before the swap
+void captureFinish ();      // writes the frames still in flight and closes the file
+
+/* Frames captured, their throughput in frames/s and the stalls */
+void captureReport (FILE* out);
+
+#endif
@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include <glm/gtx/transform.hpp>
+
+#include "drawlist.h"
+#include "jobs.h"
+#include "profiler.h"
+
+using namespace std;
+
+/* Whether any of the box lo..hi may show: it is only culled when all
+   eight corners lie beyond the same side of the clip volume */
+static bool visible (const glm::mat4& VP, const glm::vec3& lo, const glm::vec3& hi)
+{
+    int outside[6] = {0};
+    for (int c=0; c<8; c++) {
+        glm::vec4 p = VP * glm::vec4(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z, 1);
+        outside[0] += p.x < -p.w;
+        outside[1] += p.x > p.w;
+        outside[2] += p.y < -p.w;
+        outside[3] += p.y > p.w;
+        outside[4] += p.z < -p.w;
+        outside[5] += p.z > p.w;
+    }
+    for (int s=0; s<6; s++)
+        if (outside[s] == 8)
+            return false;
+    return true;
+}
+
+/* Tiles begin..end-1 and their obstacles; the boxes are the extents of
+   the models createRectangle() and createObstacle() make */
+static void recordChunk (DrawList& list, const SimSnapshot& sim, const glm::mat4& VP, int begin, int end)
+{
+    const Level& level = *sim.level;
+    list.ntiles = list.nobstacles = list.culled = 0;
+    for (int i=begin; i<end; i++) {
+        const Rectangle& tile = level.tiles[i];
+        float top = sim.tiley[i];
+        if (visible(VP, glm::vec3(tile.x - 0.5f, top - 2, tile.z - 0.5f), glm::vec3(tile.x + 0.5f, top, tile.z + 0.5f))) {
+            DrawCommand& command = list.tiles[list.ntiles++];
+            command.vao = tile.rectangle;
+            command.mvp = VP * glm::translate(glm::vec3(tile.x, top, tile.z));
+        }
+        else
+            list.culled++;
+
+        if (level.b[i] != 1)
+            continue;
+        const Obstacle& obstacle = level.obstacles[i];
+        if (visible(VP, glm::vec3(obstacle.x - 0.25f, obstacle.y - 0.5f, obstacle.z - 0.25f),
+                    glm::vec3(obstacle.x + 0.25f, obstacle.y, obstacle.z + 0.25f))) {
+            DrawCommand& command = list.obstacles[list.nobstacles++];
+            command.vao = obstacle.obstacle;
+            command.mvp = VP * glm::translate(glm::vec3(obstacle.x, obstacle.y, obstacle.z));
+        }
+        else
+            list.culled++;
+    }
+}
+
+void recordDraws (FrameDraws& draws, const SimSnapshot& sim, const glm::mat4& VP)
+{
+    int n = sim.ntiles;
+    draws.nchunks = (n + DRAW_CHUNK - 1)/DRAW_CHUNK;
+    // One job per chunk; each writes only its own list
+    parallelFor(draws.nchunks, 1, PHASE_DRAW_JOB, [&] (int begin, int end) {
+        for (int c=begin; c<end; c++)
+            recordChunk(draws.chunks[c], sim, VP, c*DRAW_CHUNK, min(n, (c + 1)*DRAW_CHUNK));
+    });
+}
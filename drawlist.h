@@ -0,0 +1,42 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "sim.h"
+
+/* The tiles and obstacles of a frame, culled and with their MVPs worked
+   out ahead of drawing. The field is split into chunks of DRAW_CHUNK tiles
+   and each chunk's list is recorded by a job (see jobs.h), so this part
+   of a frame is spread over the cores. Nothing here touches GL: the GL
+   thread replays the lists afterwards, chunk by chunk, which draws in the
+   same order as recording on one thread would. */
+
+/* One draw to replay: the model and the MVP to draw it with */
+struct DrawCommand {
+    VAO* vao;
+    glm::mat4 mvp;
+};
+
+const int DRAW_CHUNK = 64;
+const int DRAW_CHUNKS = (1000 + DRAW_CHUNK - 1)/DRAW_CHUNK;
+
+/* The visible tiles and obstacles of one chunk of tiles */
+struct DrawList {
+    int ntiles, nobstacles;
+    int culled;                 // tiles and obstacles outside the view
+    DrawCommand tiles[DRAW_CHUNK];
+    DrawCommand obstacles[DRAW_CHUNK];
+};
+
+struct FrameDraws {
+    int nchunks;
+    DrawList chunks[DRAW_CHUNKS];
+};
+
+/* Records the draws of snapshot 'sim' seen through view-projection 'VP'
+   into 'draws', and returns once every chunk is recorded */
+void recordDraws (FrameDraws& draws, const SimSnapshot& sim, const glm::mat4& VP);
+
+#endif
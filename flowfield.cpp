@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "flowfield.h"
+
+using namespace std;
+
+static const int dx[4] = {1, -1, 0, 0};
+static const int dz[4] = {0, 0, 1, -1};
+
+static int neighbour (const DistanceField& field, int cell, int d)
+{
+    int cx = cell % field.width + dx[d], cz = cell / field.width + dz[d];
+    if (cx < 0 || cz < 0 || cx >= field.width || cz >= field.height)
+        return -1;
+    return cz*field.width + cx;
+}
+
+/* Point 'cell' at any neighbour one step closer to the goal */
+static void pointCell (DistanceField& field, int cell)
+{
+    field.next[cell] = -1;
+    if (cell == field.goal || field.dist[cell] >= FIELD_UNREACHABLE)
+        return;
+    for (int d=0; d<4; d++) {
+        int n = neighbour(field, cell, d);
+        if (n != -1 && field.dist[n] == field.dist[cell] - 1) {
+            field.next[cell] = n;
+            return;
+        }
+    }
+}
+
+void buildDistanceField (DistanceField& field, const Grid& grid, int goal)
+{
+    int cells = grid.width*grid.height;
+    field.width = grid.width;
+    field.height = grid.height;
+    field.goal = goal;
+    field.dist.assign(cells, FIELD_UNREACHABLE);
+    field.next.assign(cells, -1);
+    field.mark.assign(cells, 0);
+    field.queue.clear();
+    if (!isWalkable(grid, goal))
+        return;
+
+    field.dist[goal] = 0;
+    field.queue.push_back(goal);
+    for (size_t head = 0; head < field.queue.size(); head++) {
+        int cell = field.queue[head];
+        for (int d=0; d<4; d++) {
+            int n = neighbour(field, cell, d);
+            if (n == -1 || field.dist[n] != FIELD_UNREACHABLE || !isWalkable(grid, n))
+                continue;
+            field.dist[n] = field.dist[cell] + 1;
+            field.next[n] = cell;
+            field.queue.push_back(n);
+        }
+    }
+}
+
+/* Lower distances outwards from the cells already in the queue */
+static void spreadDecrease (DistanceField& field, const Grid& grid)
+{
+    typedef pair<int, int> Entry;     // (distance, cell)
+    vector<Entry> heap;
+    for (size_t i=0; i<field.queue.size(); i++)
+        if (field.dist[field.queue[i]] < FIELD_UNREACHABLE)
+            heap.push_back(Entry(field.dist[field.queue[i]], field.queue[i]));
+    make_heap(heap.begin(), heap.end(), greater<Entry>());
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), greater<Entry>());
+        Entry top = heap.back();
+        heap.pop_back();
+        if (top.first != field.dist[top.second])
+            continue;
+        for (int d=0; d<4; d++) {
+            int n = neighbour(field, top.second, d);
+            if (n == -1 || !isWalkable(grid, n) || field.dist[n] <= top.first + 1)
+                continue;
+            field.dist[n] = top.first + 1;
+            field.touched.push_back(n);
+            heap.push_back(Entry(top.first + 1, n));
+            push_heap(heap.begin(), heap.end(), greater<Entry>());
+        }
+    }
+}
+
+void repairDistanceField (DistanceField& field, const Grid& grid, int cell)
+{
+    field.touched.clear();
+    field.queue.clear();
+    field.touched.push_back(cell);
+
+    if (isWalkable(grid, cell)) {
+        // Opened up: it can only shorten routes through it
+        int best = cell == field.goal ? 0 : FIELD_UNREACHABLE;
+        for (int d=0; d<4; d++) {
+            int n = neighbour(field, cell, d);
+            if (n != -1 && field.dist[n] < FIELD_UNREACHABLE)
+                best = min(best, field.dist[n] + 1);
+        }
+        field.dist[cell] = min(field.dist[cell], best);
+        field.queue.push_back(cell);
+        spreadDecrease(field, grid);
+    }
+    else if (field.dist[cell] < FIELD_UNREACHABLE) {
+        // Blocked: first collect every cell left without a neighbour one
+        // step closer that is itself still valid
+        field.mark[cell] = 1;
+        field.queue.push_back(cell);
+        for (size_t head = 0; head < field.queue.size(); head++) {
+            int u = field.queue[head];
+            for (int d=0; d<4; d++) {
+                int v = neighbour(field, u, d);
+                if (v == -1 || field.mark[v] || v == field.goal || field.dist[v] >= FIELD_UNREACHABLE)
+                    continue;
+                bool supported = false;
+                for (int e=0; e<4 && !supported; e++) {
+                    int w = neighbour(field, v, e);
+                    supported = w != -1 && !field.mark[w] && field.dist[w] == field.dist[v] - 1;
+                }
+                if (supported)
+                    continue;
+                field.mark[v] = 1;
+                field.queue.push_back(v);
+            }
+        }
+
+        // Then reseed them from their untouched neighbours and spread
+        for (size_t i=0; i<field.queue.size(); i++)
+            field.dist[field.queue[i]] = FIELD_UNREACHABLE;
+        for (size_t i=0; i<field.queue.size(); i++) {
+            int u = field.queue[i];
+            field.mark[u] = 0;
+            field.touched.push_back(u);
+            if (!isWalkable(grid, u))
+                continue;
+            for (int d=0; d<4; d++) {
+                int n = neighbour(field, u, d);
+                if (n != -1 && field.dist[n] < FIELD_UNREACHABLE)
+                    field.dist[u] = min(field.dist[u], field.dist[n] + 1);
+            }
+        }
+        spreadDecrease(field, grid);
+    }
+
+    // Re-point everything whose distance moved, and whoever stepped onto it
+    for (size_t i=0; i<field.touched.size(); i++) {
+        int u = field.touched[i];
+        pointCell(field, u);
+        for (int d=0; d<4; d++) {
+            int n = neighbour(field, u, d);
+            if (n != -1)
+                pointCell(field, n);
+        }
+    }
+}
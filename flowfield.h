@@ -0,0 +1,33 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <vector>
+
+#include "maze.h"
+
+const int FIELD_UNREACHABLE = 0x3fffffff;
+
+/* Walking distance from every cell to one goal cell, plus the neighbour to
+   step to next. Built by one BFS out of the goal; any number of agents can
+   then navigate with a lookup per step instead of a search each. */
+struct DistanceField {
+    int width, height;
+    int goal;
+    std::vector<int> dist;              // steps to the goal, FIELD_UNREACHABLE if cut off
+    std::vector<int> next;              // cell to step to, -1 at the goal or when cut off
+    std::vector<int> queue, touched;    // scratch kept between repairs
+    std::vector<unsigned char> mark;
+};
+typedef struct DistanceField DistanceField;
+
+void buildDistanceField (DistanceField& field, const Grid& grid, int goal);
+
+/* Bring the field up to date after the tile at 'cell' changed between
+   walkable and blocked. Only cells whose distance depended on it are
+   touched, so a local change costs about as much as the area it affects. */
+void repairDistanceField (DistanceField& field, const Grid& grid, int cell);
+
+inline int fieldStep (const DistanceField& field, int cell) { return field.next[cell]; }
+inline int fieldDistance (const DistanceField& field, int cell) { return field.dist[cell]; }
+
+#endif
@@ -0,0 +1,202 @@
+#ifdef GL_COUNT
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "glcount.h"
+
+using namespace std;
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+/* The counted entry points; the second column marks the ones that make
+   the driver answer right away instead of queueing the call */
+#define GL_COUNTED(X) \
+    X(glActiveTexture, false) \
+    X(glAttachShader, false) \
+    X(glBeginQuery, false) \
+    X(glBindBuffer, false) \
+    X(glBindFramebuffer, false) \
+    X(glBindRenderbuffer, false) \
+    X(glBindTexture, false) \
+    X(glBindVertexArray, false) \
+    X(glBlendFunc, false) \
+    X(glBufferData, false) \
+    X(glBufferSubData, false) \
+    X(glClear, false) \
+    X(glClearColor, false) \
+    X(glClearDepth, false) \
+    X(glCompileShader, false) \
+    X(glCreateProgram, false) \
+    X(glCreateShader, false) \
+    X(glDeleteBuffers, false) \
+    X(glDeleteProgram, false) \
+    X(glDeleteShader, false) \
+    X(glDeleteSync, false) \
+    X(glDeleteVertexArrays, false) \
+    X(glDepthFunc, false) \
+    X(glDisable, false) \
+    X(glDisableVertexAttribArray, false) \
+    X(glDrawArrays, false) \
+    X(glDrawElements, false) \
+    X(glEnable, false) \
+    X(glEnableVertexAttribArray, false) \
+    X(glEndQuery, false) \
+    X(glFenceSync, false) \
+    X(glFlush, false) \
+    X(glFramebufferRenderbuffer, false) \
+    X(glGenBuffers, false) \
+    X(glGenFramebuffers, false) \
+    X(glGenQueries, false) \
+    X(glGenRenderbuffers, false) \
+    X(glGenVertexArrays, false) \
+    X(glLinkProgram, false) \
+    X(glPixelStorei, false) \
+    X(glPolygonMode, false) \
+    X(glProgramBinary, false) \
+    X(glProgramParameteri, false) \
+    X(glRenderbufferStorage, false) \
+    X(glScissor, false) \
+    X(glShaderSource, false) \
+    X(glUniform1i, false) \
+    X(glUniform1f, false) \
+    X(glUniform3fv, false) \
+    X(glUniform4fv, false) \
+    X(glUniformMatrix4fv, false) \
+    X(glUnmapBuffer, false) \
+    X(glUseProgram, false) \
+    X(glVertexAttribPointer, false) \
+    X(glViewport, false) \
+    X(glWaitSync, false) \
+    X(glCheckFramebufferStatus, true) \
+    X(glClientWaitSync, true) \
+    X(glFinish, true) \
+    X(glGetAttribLocation, true) \
+    X(glGetBooleanv, true) \
+    X(glGetBufferSubData, true) \
+    X(glGetError, true) \
+    X(glGetFloatv, true) \
+    X(glGetProgramBinary, true) \
+    X(glGetIntegerv, true) \
+    X(glGetProgramInfoLog, true) \
+    X(glGetProgramiv, true) \
+    X(glGetQueryObjectiv, true) \
+    X(glGetQueryObjectui64v, true) \
+    X(glGetShaderInfoLog, true) \
+    X(glGetShaderiv, true) \
+    X(glGetString, true) \
+    X(glGetUniformLocation, true) \
+    X(glMapBufferRange, true) \
+    X(glReadPixels, true)
+
+enum GlCall {
+#define GL_ENUM(name, sync) GLC_##name,
+    GL_COUNTED(GL_ENUM)
+#undef GL_ENUM
+    GLC_COUNT
+};
+
+struct GlCallInfo {
+    const char* name;
+    bool sync;
+};
+
+static const GlCallInfo calls[GLC_COUNT] = {
+#define GL_INFO(name, sync) {#name, sync},
+    GL_COUNTED(GL_INFO)
+#undef GL_INFO
+};
+
+static atomic<long> thisframe[GLC_COUNT];  // calls since the last glCountFrame(), from any thread
+static long peak[GLC_COUNT];        // most calls in one frame
+static long long total[GLC_COUNT];  // calls over all finished frames
+static long startup[GLC_COUNT];     // calls before the first frame
+static atomic<bool> flagged[GLC_COUNT];
+static atomic<long> frames(-1);     // -1 until the frame loop starts; read from any thread
+
+static void counted (int call)
+{
+    thisframe[call].fetch_add(1, memory_order_relaxed);
+    long frame = frames.load(memory_order_relaxed);
+    if (calls[call].sync && frame >= 0 && !flagged[call].exchange(true, memory_order_relaxed))
+        fprintf(stderr, "GL count: %s called in the frame loop (frame %ld) waits on the driver\n",
+                calls[call].name, frame);
+}
+
+/* One wrapper per entry point, with the driver's signature taken from the
+   glad pointer's own type */
+template <int Call, class F> struct Hook;
+
+template <int Call, class R, class... Args>
+struct Hook<Call, R (APIENTRY *)(Args...)> {
+    static R (APIENTRY *real)(Args...);
+    static R APIENTRY call (Args... args)
+    {
+        counted(Call);
+        return real(args...);
+    }
+};
+
+template <int Call, class R, class... Args>
+R (APIENTRY *Hook<Call, R (APIENTRY *)(Args...)>::real)(Args...);
+
+void glCountInit ()
+{
+    // Entry points the driver doesn't have stay NULL, as glad left them
+#define GL_HOOK(name, sync) \
+    if (glad_##name) { \
+        Hook<GLC_##name, decltype(glad_##name)>::real = glad_##name; \
+        glad_##name = Hook<GLC_##name, decltype(glad_##name)>::call; \
+    }
+    GL_COUNTED(GL_HOOK)
+#undef GL_HOOK
+}
+
+void glCountFrame ()
+{
+    bool started = frames.load(memory_order_relaxed) >= 0;
+    for (int i=0; i<GLC_COUNT; i++) {
+        long n = thisframe[i].exchange(0, memory_order_relaxed);
+        if (!started)
+            startup[i] = n;
+        else {
+            total[i] += n;
+            peak[i] = max(peak[i], n);
+        }
+    }
+    frames++;
+}
+
+static bool busier (int a, int b)
+{
+    return total[a] != total[b] ? total[a] > total[b] : startup[a] > startup[b];
+}
+
+void glCountReport (FILE* out)
+{
+    vector<int> order;
+    long long all = 0;
+    for (int i=0; i<GLC_COUNT; i++) {
+        all += total[i];
+        if (total[i] || startup[i])
+            order.push_back(i);
+    }
+    sort(order.begin(), order.end(), busier);
+
+    long finished = frames.load();
+    long n = max(finished, 1L);
+    fprintf(out, "GL calls over %ld frames, %.1f per frame (* waits on the driver)\n", max(finished, 0L), (double)all/n);
+    fprintf(out, "%-28s %10s %8s %10s\n", "function", "per frame", "max", "start-up");
+    for (size_t i=0; i<order.size() && i<20; i++) {
+        int c = order[i];
+        fprintf(out, "%-26s %s %10.1f %8ld %10ld\n", calls[c].name, calls[c].sync ? " *" : "  ",
+                (double)total[c]/n, peak[c], startup[c]);
+    }
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GLCOUNT_H
+#define GLCOUNT_H
+
+#include <cstdio>
+
+/* GL call counting for finding driver overhead, built in with -DGL_COUNT.
+   glCountInit() swaps glad's function pointers for the GL calls the game
+   makes, plus the usual synchronous queries, with wrappers that count each
+   call and then call the driver. Queries that wait on the driver (glGet*,
+   glGetError, glFinish, glReadPixels) are flagged the first time one runs
+   inside the frame loop. Without -DGL_COUNT these do nothing. */
+#ifdef GL_COUNT
+void glCountInit ();            // right after gladLoadGLLoader()
+void glCountFrame ();           // at the top of every frame; calls before the first are start-up
+void glCountReport (FILE* out); // the top offenders by calls per frame
+#else
+inline void glCountInit () {}
+inline void glCountFrame () {}
+inline void glCountReport (FILE*) {}
+#endif
+
+#endif
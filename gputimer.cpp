@@ -0,0 +1,76 @@
+#include "gputimer.h"
+
+const int GPU_FIRST = PHASE_GPU_CLEAR;
+const int GPU_PASSES = PHASE_COUNT - PHASE_GPU_CLEAR;
+
+static GLuint queries[2][GPU_PASSES];
+static bool issued[2][GPU_PASSES];
+static int frame = 0, active = -1;
+static bool available = false;
+static long long lastframe = 0;
+
+void gpuTimersInit ()
+{
+    // Timer queries are core since 3.3, an extension before that
+    available = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+    if (available)
+        glGenQueries(2*GPU_PASSES, &queries[0][0]);
+}
+
+void gpuTimersBeginFrame ()
+{
+    frame++;
+    if (!available)
+        return;
+    int set = frame % 2;
+    bool ready = true;
+    for (int p=0; p<GPU_PASSES && ready; p++) {
+        if (!issued[set][p])
+            continue;
+        GLint done = 0;
+        glGetQueryObjectiv(queries[set][p], GL_QUERY_RESULT_AVAILABLE, &done);
+        ready = done != 0;
+    }
+    long long total = 0;
+    bool any = false;
+    for (int p=0; p<GPU_PASSES; p++) {
+        if (!issued[set][p])
+            continue;
+        issued[set][p] = false;
+        if (!ready)
+            continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[set][p], GL_QUERY_RESULT, &ns);
+        profileRecord((ProfilePhase)(GPU_FIRST + p), 0, ns);
+        total += ns;
+        any = true;
+    }
+    if (any) {
+        profileRecord(PHASE_GPU_DRAW, 0, total);
+        lastframe = total;
+    }
+}
+
+long long gpuLastFrameTime ()
+{
+    return lastframe;
+}
+
+bool gpuPassBegin (ProfilePhase pass)
+{
+    if (!available || active != -1)
+        return false;
+    int set = frame % 2;
+    active = pass - GPU_FIRST;
+    glBeginQuery(GL_TIME_ELAPSED, queries[set][active]);
+    issued[set][active] = true;
+    return true;
+}
+
+void gpuPassEnd ()
+{
+    if (active == -1)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    active = -1;
+}
@@ -0,0 +1,36 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+#include "profiler.h"
+
+/* GL_TIME_ELAPSED queries around the render passes of draw(). There are
+   two sets of queries used on alternate frames, so the results read back
+   at the start of a frame are from the frame two back, the last one to use
+   the same set; if the GPU has not finished them yet they are dropped
+   rather than waited for. Results go
+   into the profiler rings and show up in profileReport(). */
+void gpuTimersInit ();
+void gpuTimersBeginFrame ();
+bool gpuPassBegin (ProfilePhase pass);
+void gpuPassEnd ();
+
+/* Nanoseconds of GPU time of the most recent frame read back */
+long long gpuLastFrameTime ();
+
+/* Times the GL commands issued in the enclosing block. Passes can not be
+   nested: only one GL_TIME_ELAPSED query may be active at a time. */
+struct GpuScope {
+    bool started;
+    GpuScope (ProfilePhase pass) : started(gpuPassBegin(pass)) {}
+    ~GpuScope () { if (started) gpuPassEnd(); }
+};
+
+#ifndef NO_PROFILE
+#define GPU_SCOPE(pass) GpuScope PROFILE_JOIN(gpu_scope_, __LINE__)(pass)
+#else
+#define GPU_SCOPE(pass) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "headless.h"
+#include "glcount.h"
+
+using namespace std;
+
+/* Stands in for GLFW's window: the offscreen target and a frame budget,
+   or, made by glfwCreateWindow(), just a context sharing its objects */
+struct GLFWwindow {
+    int width, height;
+    long frames, swapped;
+    GLuint framebuffer, color, depth;
+    EGLContext context;
+    EGLSurface surface;
+};
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLConfig config;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+static GLFWwindow headless;
+static chrono::steady_clock::time_point started;
+
+static void fail (const char* what)
+{
+    fprintf(stderr, "Headless: %s failed (EGL error 0x%x)\n", what, eglGetError());
+    exit(EXIT_FAILURE);
+}
+
+static bool hasExtension (const char* list, const char* name)
+{
+    size_t n = strlen(name);
+    for (const char* p = list; p && (p = strstr(p, name)); p += n)
+        if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0'))
+            return true;
+    return false;
+}
+
+static EGLDisplay openDisplay ()
+{
+    // Mesa's surfaceless platform needs neither X nor a GPU device node
+    const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(client, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL))
+                return d;
+        }
+    }
+    EGLDisplay d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (d == EGL_NO_DISPLAY || !eglInitialize(d, NULL, NULL))
+        fail("eglInitialize");
+    return d;
+}
+
+/* Same context as initGLFW asks for: 3.3 core */
+static EGLContext createContext (EGLContext share)
+{
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext c = eglCreateContext(display, config, share, context_attribs);
+    if (c == EGL_NO_CONTEXT)
+        fail("eglCreateContext");
+    return c;
+}
+
+static EGLSurface createPbuffer (int width, int height)
+{
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    EGLSurface s = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+    if (s == EGL_NO_SURFACE)
+        fail("eglCreatePbufferSurface");
+    return s;
+}
+
+GLFWwindow* initHeadless (int width, int height, long frames)
+{
+    display = openDisplay();
+    bool surfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &configs) || configs == 0)
+        fail("eglChooseConfig");
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+        fail("eglBindAPI");
+    context = createContext(EGL_NO_CONTEXT);
+    if (!surfaceless)
+        surface = createPbuffer(width, height);
+    if (!eglMakeCurrent(display, surface, surface, context))
+        fail("eglMakeCurrent");
+    gladLoadGLLoader((GLADloadproc) eglGetProcAddress);
+    glCountInit();
+
+    // Offscreen colour and depth buffers take the place of the window's
+    headless.width = width;
+    headless.height = height;
+    headless.frames = frames;
+    headless.swapped = 0;
+    headless.context = context;
+    headless.surface = surface;
+    glGenFramebuffers(1, &headless.framebuffer);
+    glGenRenderbuffers(1, &headless.color);
+    glGenRenderbuffers(1, &headless.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, headless.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless.color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headless.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Headless: offscreen framebuffer incomplete\n");
+        exit(EXIT_FAILURE);
+    }
+
+    started = chrono::steady_clock::now();
+    printf("Headless: %dx%d offscreen, %s, %ld frames\n", width, height,
+           surfaceless ? "surfaceless" : "pbuffer", frames);
+    return &headless;
+}
+
+GLuint headlessFramebuffer ()
+{
+    return headless.framebuffer;
+}
+
+/* The GLFW calls made after start-up */
+
+double glfwGetTime (void)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
+
+void glfwSwapBuffers (GLFWwindow* window)
+{
+    // Nothing is presented; wait for the frame like a blocking swap would
+    glFinish();
+    window->swapped++;
+}
+
+void glfwPollEvents (void)
+{
+}
+
+int glfwWindowShouldClose (GLFWwindow* window)
+{
+    return window->swapped >= window->frames;
+}
+
+void glfwGetFramebufferSize (GLFWwindow* window, int* width, int* height)
+{
+    *width = window->width;
+    *height = window->height;
+}
+
+void glfwGetCursorPos (GLFWwindow* window, double* xpos, double* ypos)
+{
+    // Cursor parked in the middle of the window
+    *xpos = window->width/2.0;
+    *ypos = window->height/2.0;
+}
+
+GLFWscrollfun glfwSetScrollCallback (GLFWwindow* window, GLFWscrollfun callback)
+{
+    return NULL;
+}
+
+void glfwWindowHint (int hint, int value)
+{
+}
+
+/* Only ever asked for a hidden window sharing 'share's objects, for a
+   thread loading in the background: a context with no framebuffer, and a
+   1x1 pbuffer where surfaceless contexts are missing */
+GLFWwindow* glfwCreateWindow (int width, int height, const char* title, GLFWmonitor* monitor, GLFWwindow* share)
+{
+    GLFWwindow* window = new GLFWwindow();
+    window->context = createContext(share ? share->context : EGL_NO_CONTEXT);
+    window->surface = surface == EGL_NO_SURFACE ? EGL_NO_SURFACE : createPbuffer(1, 1);
+    return window;
+}
+
+void glfwMakeContextCurrent (GLFWwindow* window)
+{
+    if (!window)
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    else if (!eglMakeCurrent(display, window->surface, window->surface, window->context))
+        fail("eglMakeCurrent");
+}
+
+void glfwDestroyWindow (GLFWwindow* window)
+{
+    if (window == &headless)
+        return;
+    if (window->surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, window->surface);
+    eglDestroyContext(display, window->context);
+    delete window;
+}
+
+void glfwTerminate (void)
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,19 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+/* Display-less build (make sample2D_headless, compiled with -DHEADLESS).
+   An EGL context on Mesa's surfaceless platform, or on a pbuffer where
+   that is missing, renders into an offscreen framebuffer of the window's
+   size, so draw() runs unchanged. The few GLFW calls the game makes after
+   start-up are implemented on top of it and libglfw is not linked,
+   including a hidden window sharing the context for the loader thread.
+   The "window" closes after 'frames' swaps. */
+GLFWwindow* initHeadless (int width, int height, long frames);
+
+/* The offscreen framebuffer draw() renders into */
+GLuint headlessFramebuffer ();
+
+#endif
@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "hpa.h"
+
+using namespace std;
+
+static const int dx[4] = {1, -1, 0, 0};
+static const int dz[4] = {0, 0, 1, -1};     // d^1 is the way back from d
+
+/* Cells covered by a chunk, [x0,x1) x [z0,z1) */
+struct ChunkRect {
+    int x0, z0, x1, z1;
+};
+
+static ChunkRect chunkRect (const HpaGraph& graph, const Grid& grid, int c)
+{
+    int cx = c % graph.chunks_x, cz = c / graph.chunks_x;
+    ChunkRect r = {cx*graph.chunk, cz*graph.chunk,
+                   min(grid.width, (cx+1)*graph.chunk), min(grid.height, (cz+1)*graph.chunk)};
+    return r;
+}
+
+static int chunkOf (const HpaGraph& graph, const Grid& grid, int cell)
+{
+    return (cellZ(grid, cell)/graph.chunk)*graph.chunks_x + cellX(grid, cell)/graph.chunk;
+}
+
+/* BFS confined to one chunk. Cells are indexed by position inside the
+   chunk with a ring of closed cells around it, so stepping to a neighbour
+   needs no bounds check. */
+struct ChunkSearch {
+    ChunkRect r;
+    int pw;                     // padded width
+    vector<unsigned char> open;
+    vector<int> dist, parent, queue;
+    vector<int> entrances;      // the chunk's entrance cells, as indexed here
+
+    int local (const Grid& grid, int cell) const
+    {
+        return (cellZ(grid, cell) - r.z0 + 1)*pw + cellX(grid, cell) - r.x0 + 1;
+    }
+
+    int global (const Grid& grid, int index) const
+    {
+        return cellIndex(grid, r.x0 + index % pw - 1, r.z0 + index / pw - 1);
+    }
+
+    /* Takes in the chunk's walkable cells for the searches that follow */
+    void prepare (const Grid& grid, const ChunkRect& rect)
+    {
+        r = rect;
+        pw = r.x1 - r.x0 + 2;
+        open.assign(pw*(r.z1 - r.z0 + 2), 0);
+        for (int z=r.z0; z<r.z1; z++)
+            for (int x=r.x0; x<r.x1; x++)
+                open[(z - r.z0 + 1)*pw + x - r.x0 + 1] = isWalkable(grid, cellIndex(grid, x, z));
+        dist.resize(open.size());
+        parent.resize(open.size());
+    }
+
+    void run (const Grid& grid, int source)
+    {
+        const int step[4] = {1, -1, pw, -pw};
+        fill(dist.begin(), dist.end(), -1);
+        queue.clear();
+        int first = local(grid, source);
+        dist[first] = 0;
+        parent[first] = -1;
+        queue.push_back(first);
+        for (size_t head = 0; head < queue.size(); head++) {
+            int u = queue[head];
+            for (int d=0; d<4; d++) {
+                int v = u + step[d];
+                if (!open[v] || dist[v] != -1)
+                    continue;
+                dist[v] = dist[u] + 1;
+                parent[v] = u;
+                queue.push_back(v);
+            }
+        }
+    }
+
+    int distance (const Grid& grid, int cell) const
+    {
+        return dist[local(grid, cell)];
+    }
+
+    /* Append the cells after the source up to and including 'cell' */
+    void appendPath (const Grid& grid, int cell, vector<int>& path) const
+    {
+        size_t from = path.size();
+        for (int u = local(grid, cell); parent[u] != -1; u = parent[u])
+            path.push_back(global(grid, u));
+        reverse(path.begin() + from, path.end());
+    }
+
+    /* Append the cells after 'cell' back down to the source */
+    void appendPathBack (const Grid& grid, int cell, vector<int>& path) const
+    {
+        for (int u = parent[local(grid, cell)]; u != -1; u = parent[u])
+            path.push_back(global(grid, u));
+    }
+
+    /* The directions walked from the source to local cell 'v', last first */
+    void directionsBack (int v, vector<unsigned char>& out) const
+    {
+        out.clear();
+        for (; parent[v] != -1; v = parent[v]) {
+            int diff = v - parent[v];
+            out.push_back(diff == 1 ? 0 : diff == -1 ? 1 : diff == pw ? 2 : 3);
+        }
+    }
+};
+static thread_local ChunkSearch chunksearch, goalsearch;
+static thread_local vector<unsigned char> directions;
+
+static int stepAt (const HpaChunk& chunk, int k)
+{
+    return (chunk.steps[k/4] >> 2*(k%4)) & 3;
+}
+
+/* Append the cells after entrance 'i' of chunk 'c' up to and including
+   entrance 'j', from the path kept for the pair */
+static void appendRoute (const HpaGraph& graph, const Grid& grid, int c, int i, int j, vector<int>& path)
+{
+    const HpaChunk& chunk = graph.chunks[c];
+    int n = chunk.cells.size();
+    int cell = chunk.cells[i];
+    int len = chunk.dist[i*n + j];
+    if (i < j) {
+        int first = chunk.route[i*n + j];
+        for (int s=0; s<len; s++) {
+            int d = stepAt(chunk, first + s);
+            cell += dx[d] + dz[d]*grid.width;
+            path.push_back(cell);
+        }
+    } else {
+        // Only j to i is kept: walk it backwards
+        int first = chunk.route[j*n + i];
+        for (int s=len-1; s>=0; s--) {
+            int d = stepAt(chunk, first + s) ^ 1;
+            cell += dx[d] + dz[d]*grid.width;
+            path.push_back(cell);
+        }
+    }
+}
+
+/* One border side of a chunk: walk 'len' cells from (x,z) in steps of
+   (sx,sz); the cell across the border is at offset (ox,oz). Each run of
+   open pairs gets an entrance in its middle, long runs one at each end. */
+static void scanBorder (const Grid& grid, int x, int z, int sx, int sz, int len, int ox, int oz, vector<int>& cells)
+{
+    int run = 0;
+    for (int i=0; i<=len; i++) {
+        int cx = x + i*sx, cz = z + i*sz;
+        if (i < len && isWalkable(grid, cx, cz) && isWalkable(grid, cx + ox, cz + oz)) {
+            run++;
+            continue;
+        }
+        if (run == 0)
+            continue;
+        int first = i - run, last = i - 1;
+        if (run < 6)
+            cells.push_back(cellIndex(grid, x + (first + last)/2*sx, z + (first + last)/2*sz));
+        else {
+            cells.push_back(cellIndex(grid, x + first*sx, z + first*sz));
+            cells.push_back(cellIndex(grid, x + last*sx, z + last*sz));
+        }
+        run = 0;
+    }
+}
+
+static void buildChunk (HpaGraph& graph, const Grid& grid, int c)
+{
+    ChunkRect r = chunkRect(graph, grid, c);
+    int w = r.x1 - r.x0, h = r.z1 - r.z0;
+    vector<int>& cells = graph.chunks[c].cells;
+    cells.clear();
+    if (r.x0 > 0)
+        scanBorder(grid, r.x0, r.z0, 0, 1, h, -1, 0, cells);
+    if (r.x1 < grid.width)
+        scanBorder(grid, r.x1-1, r.z0, 0, 1, h, 1, 0, cells);
+    if (r.z0 > 0)
+        scanBorder(grid, r.x0, r.z0, 1, 0, w, 0, -1, cells);
+    if (r.z1 < grid.height)
+        scanBorder(grid, r.x0, r.z1-1, 1, 0, w, 0, 1, cells);
+    sort(cells.begin(), cells.end());
+    cells.erase(unique(cells.begin(), cells.end()), cells.end());
+
+    // Distances between every pair of entrances, and the path of each pair
+    // one way round, read off the parents of a search from each entrance
+    int n = cells.size();
+    HpaChunk& chunk = graph.chunks[c];
+    ChunkSearch& search = chunksearch;
+    search.prepare(grid, r);
+    search.entrances.resize(n);
+    for (int j=0; j<n; j++)
+        search.entrances[j] = search.local(grid, cells[j]);
+    chunk.dist.assign(n*n, -1);
+    chunk.route.assign(n*n, -1);
+    chunk.steps.clear();
+    int stored = 0;
+    for (int i=0; i<n; i++) {
+        search.run(grid, cells[i]);
+        for (int j=0; j<n; j++) {
+            int d = search.dist[search.entrances[j]];
+            chunk.dist[i*n + j] = d;
+            if (j <= i || d <= 0)
+                continue;
+            chunk.route[i*n + j] = stored;
+            search.directionsBack(search.entrances[j], directions);
+            for (int s=d-1; s>=0; s--, stored++) {
+                if (stored % 4 == 0)
+                    chunk.steps.push_back(0);
+                chunk.steps.back() |= directions[s] << 2*(stored % 4);
+            }
+        }
+    }
+
+    // A hop from i to j that some shortest path makes through another
+    // entrance k is left out: the search gets there by way of k at the
+    // same cost, and by induction on the distance every such hop is made
+    // of ones that are kept
+    chunk.hops.clear();
+    chunk.hopstart.assign(n + 1, 0);
+    for (int i=0; i<n; i++) {
+        chunk.hopstart[i] = chunk.hops.size();
+        for (int j=0; j<n; j++) {
+            int d = chunk.dist[i*n + j];
+            if (j == i || d <= 0)
+                continue;
+            bool through = false;
+            for (int k=0; k<n && !through; k++) {
+                int a = chunk.dist[i*n + k], b = chunk.dist[k*n + j];
+                through = k != i && k != j && a > 0 && b > 0 && a + b == d;
+            }
+            if (!through)
+                chunk.hops.push_back(j);
+        }
+    }
+    chunk.hopstart[n] = chunk.hops.size();
+}
+
+void buildHpaGraph (HpaGraph& graph, const Grid& grid, int chunk)
+{
+    graph.chunk = chunk;
+    graph.chunks_x = (grid.width + chunk - 1)/chunk;
+    graph.chunks_z = (grid.height + chunk - 1)/chunk;
+    graph.chunks.assign(graph.chunks_x*graph.chunks_z, HpaChunk());
+    for (size_t c=0; c<graph.chunks.size(); c++)
+        buildChunk(graph, grid, c);
+}
+
+void repairHpaGraph (HpaGraph& graph, const Grid& grid, int cell)
+{
+    int c = chunkOf(graph, grid, cell);
+    ChunkRect r = chunkRect(graph, grid, c);
+    int x = cellX(grid, cell), z = cellZ(grid, cell);
+    buildChunk(graph, grid, c);
+    // Entrances of a neighbour only depend on the border it shares with us
+    if (x == r.x0 && r.x0 > 0)
+        buildChunk(graph, grid, c - 1);
+    if (x == r.x1-1 && r.x1 < grid.width)
+        buildChunk(graph, grid, c + 1);
+    if (z == r.z0 && r.z0 > 0)
+        buildChunk(graph, grid, c - graph.chunks_x);
+    if (z == r.z1-1 && r.z1 < grid.height)
+        buildChunk(graph, grid, c + graph.chunks_x);
+}
+
+struct AbstractOpen {
+    int f, g, key;
+    bool operator< (const AbstractOpen& o) const { return f > o.f || (f == o.f && g < o.g); }
+};
+
+/* Per-thread abstract search state, reused between queries. Entrance
+   nodes are keyed chunk*slots + slot, with the start and goal after the
+   last chunk's, and stamped by generation like the scratch of
+   pathfinding.cpp, so nothing is cleared or allocated per query. */
+struct AbstractNode {
+    unsigned int seen, closed;  // generation stamps
+    int g, h, parent;
+};
+
+struct AbstractScratch {
+    vector<AbstractNode> nodes;
+    vector<AbstractOpen> open;
+    vector<int> route;
+    unsigned int gen;
+
+    void begin (size_t n)
+    {
+        if (nodes.size() != n || gen == ~0u) {
+            AbstractNode unseen = {0, 0, 0, 0, 0};
+            nodes.assign(n, unseen);
+            gen = 0;
+        }
+        gen++;
+        open.clear();
+    }
+};
+static thread_local AbstractScratch abstract;
+
+bool findPathHPA (const HpaGraph& graph, const Grid& grid, int start, int goal, vector<int>& path, PathStats* stats)
+{
+    path.clear();
+    if (stats)
+        stats->expanded = stats->touched = 0;
+    int cells = grid.width*grid.height;
+    if (start < 0 || goal < 0 || start >= cells || goal >= cells || !isWalkable(grid, start) || !isWalkable(grid, goal))
+        return false;
+
+    // Inside one chunk the local search is all we need
+    int cs = chunkOf(graph, grid, start), cg = chunkOf(graph, grid, goal);
+    chunksearch.prepare(grid, chunkRect(graph, grid, cs));
+    chunksearch.run(grid, start);
+    if (cs == cg && chunksearch.distance(grid, goal) != -1) {
+        path.push_back(start);
+        chunksearch.appendPath(grid, goal, path);
+        return true;
+    }
+
+    // Link start and goal into the entrances of their chunks; the searches
+    // stay on for expanding the first and last hop
+    goalsearch.prepare(grid, chunkRect(graph, grid, cg));
+    goalsearch.run(grid, goal);
+    const HpaChunk& first = graph.chunks[cs];
+    const HpaChunk& last = graph.chunks[cg];
+
+    const int slots = 4*graph.chunk;
+    const int START = graph.chunks.size()*slots, GOAL = START + 1;
+    AbstractScratch& s = abstract;
+    s.begin(START + 2);
+    int gx = cellX(grid, goal), gz = cellZ(grid, goal);
+
+    auto relax = [&] (int key, int cell, int g, int parent) {
+        if (stats)
+            stats->touched++;
+        AbstractNode& node = s.nodes[key];
+        if (node.seen != s.gen) {
+            node.seen = s.gen;
+            node.h = abs(cellX(grid, cell) - gx) + abs(cellZ(grid, cell) - gz);
+        } else if (node.closed == s.gen || node.g <= g)
+            return;
+        node.g = g;
+        node.parent = parent;
+        AbstractOpen entry = {g + node.h, g, key};
+        s.open.push_back(entry);
+        push_heap(s.open.begin(), s.open.end());
+    };
+
+    s.nodes[START].seen = s.nodes[START].closed = s.gen;
+    for (size_t i=0; i<first.cells.size(); i++) {
+        int d = chunksearch.distance(grid, first.cells[i]);
+        if (d != -1)
+            relax(cs*slots + i, first.cells[i], d, START);
+    }
+
+    bool found = false;
+    while (!s.open.empty()) {
+        pop_heap(s.open.begin(), s.open.end());
+        AbstractOpen top = s.open.back();
+        s.open.pop_back();
+        AbstractNode& node = s.nodes[top.key];
+        if (node.closed == s.gen || node.g != top.g)
+            continue;
+        node.closed = s.gen;
+        if (stats)
+            stats->expanded++;
+        if (top.key == GOAL) {
+            found = true;
+            break;
+        }
+
+        int c = top.key / slots, i = top.key % slots;
+        const HpaChunk& chunk = graph.chunks[c];
+        int n = chunk.cells.size();
+        int cell = chunk.cells[i];
+        if (c == cg) {
+            int d = goalsearch.distance(grid, cell);
+            if (d != -1)
+                relax(GOAL, goal, top.g + d, top.key);
+        }
+        for (int e=chunk.hopstart[i]; e<chunk.hopstart[i+1]; e++) {
+            int j = chunk.hops[e];
+            relax(c*slots + j, chunk.cells[j], top.g + chunk.dist[i*n + j], top.key);
+        }
+        // Step across each border the entrance is on into the neighbouring
+        // chunk's entrance
+        ChunkRect r = chunkRect(graph, grid, c);
+        int x = cellX(grid, cell), z = cellZ(grid, cell);
+        for (int d=0; d<4; d++) {
+            int nc;
+            if (d == 0 && x == r.x1-1 && r.x1 < grid.width)
+                nc = c + 1;
+            else if (d == 1 && x == r.x0 && r.x0 > 0)
+                nc = c - 1;
+            else if (d == 2 && z == r.z1-1 && r.z1 < grid.height)
+                nc = c + graph.chunks_x;
+            else if (d == 3 && z == r.z0 && r.z0 > 0)
+                nc = c - graph.chunks_x;
+            else
+                continue;
+            int across = cell + dx[d] + dz[d]*grid.width;
+            if (!isWalkable(grid, across))
+                continue;
+            const vector<int>& other = graph.chunks[nc].cells;
+            vector<int>::const_iterator slot = lower_bound(other.begin(), other.end(), across);
+            if (slot != other.end() && *slot == across)
+                relax(nc*slots + (slot - other.begin()), across, top.g + 1, top.key);
+        }
+    }
+    if (!found)
+        return false;
+
+    // Abstract route front to back, then expand each hop: the searches
+    // from the ends for the first and last, the kept paths inside a chunk,
+    // a single step across a border
+    s.route.clear();
+    for (int key = s.nodes[GOAL].parent; key != START; key = s.nodes[key].parent)
+        s.route.push_back(key);
+    reverse(s.route.begin(), s.route.end());
+    path.push_back(start);
+    chunksearch.appendPath(grid, first.cells[s.route[0] % slots], path);
+    for (size_t k=1; k<s.route.size(); k++) {
+        int a = s.route[k-1], b = s.route[k];
+        if (a / slots == b / slots)
+            appendRoute(graph, grid, a / slots, a % slots, b % slots, path);
+        else
+            path.push_back(graph.chunks[b / slots].cells[b % slots]);
+    }
+    goalsearch.appendPathBack(grid, last.cells[s.route.back() % slots], path);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef HPA_H
+#define HPA_H
+
+#include <cstddef>
+#include <vector>
+
+#include "maze.h"
+#include "pathfinding.h"
+
+/* Entrance graph of one chunk: the cells on its border that link to a
+   neighbouring chunk, and their walking distances within the chunk */
+struct HpaChunk {
+    std::vector<int> cells;     // entrance cells, indexed by slot
+    std::vector<int> dist;      // slots*slots distances inside the chunk, -1 if none
+    std::vector<int> route;     // for slots i < j, the first step of the i to j path in 'steps'
+    std::vector<unsigned char> steps;   // those paths as 2-bit directions, four to a byte
+    std::vector<int> hops;      // for slot i, hops[hopstart[i] .. hopstart[i+1]) are the slots
+    std::vector<int> hopstart;  // worth going to straight from i
+};
+typedef struct HpaChunk HpaChunk;
+
+/* HPA* abstraction: the grid is cut into square chunks and each run of open
+   cells along a chunk border becomes one or two entrances. Long queries
+   search the small graph of entrances and then expand each hop from the
+   shortest paths between entrances kept with every chunk. */
+struct HpaGraph {
+    int chunk;                  // side of a chunk in cells
+    int chunks_x, chunks_z;
+    std::vector<HpaChunk> chunks;
+};
+typedef struct HpaGraph HpaGraph;
+
+void buildHpaGraph (HpaGraph& graph, const Grid& grid, int chunk=32);
+
+/* Rebuild the entrance graphs touched by a change to the tile at 'cell':
+   its own chunk and the neighbours sharing a border with it */
+void repairHpaGraph (HpaGraph& graph, const Grid& grid, int cell);
+
+/* Near-shortest path from 'start' to 'goal'; same conventions as the
+   searches in pathfinding.h. Paths are optimal inside a chunk and may be a
+   few percent longer than the true shortest path overall. */
+bool findPathHPA (const HpaGraph& graph, const Grid& grid, int start, int goal, std::vector<int>& path, PathStats* stats=NULL);
+
+#endif
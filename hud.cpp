@@ -0,0 +1,174 @@
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "hud.h"
+#include "gputimer.h"
+#include "memtrack.h"
+#include "profiler.h"
+
+using namespace std;
+
+RenderStats renderstats;
+bool hudvisible = false;
+
+/* The overlay is laid out on a fixed 1600x900 canvas, origin bottom left */
+const float HUD_WIDTH = 1600, HUD_HEIGHT = 900;
+const int HISTORY = 120;            // frames in the graph
+const float GRAPH_MS = 50;          // frame time at the top of the graph
+
+/* 3x5 pixel font, rows top to bottom */
+struct Glyph {
+    char c;
+    const char* rows;
+};
+
+static const Glyph font[] = {
+    {'0', "111101101101111"}, {'1', "010110010010111"}, {'2', "111001111100111"},
+    {'3', "111001111001111"}, {'4', "101101111001001"}, {'5', "111100111001111"},
+    {'6', "111100111101111"}, {'7', "111001001001001"}, {'8', "111101111101111"},
+    {'9', "111101111001111"}, {'A', "010101111101101"}, {'B', "110101110101110"},
+    {'C', "011100100100011"}, {'D', "110101101101110"}, {'E', "111100110100111"},
+    {'F', "111100110100100"}, {'G', "011100101101011"}, {'H', "101101111101101"},
+    {'I', "111010010010111"}, {'J', "001001001101010"}, {'K', "101101110101101"},
+    {'L', "100100100100111"}, {'M', "101111111101101"}, {'N', "110101101101101"},
+    {'O', "010101101101010"}, {'P', "110101110100100"}, {'Q', "010101101110011"},
+    {'R', "110101110101101"}, {'S', "011100010001110"}, {'T', "111010010010010"},
+    {'U', "101101101101111"}, {'V', "101101101101010"}, {'W', "101101111111101"},
+    {'X', "101101010101101"}, {'Y', "101101010010010"}, {'Z', "111001010100111"},
+    {'.', "000000000000010"}, {'/', "001001010100100"}, {'-', "000000111000000"},
+    {':', "000010000010000"},
+};
+
+static unsigned short glyphs[128];
+
+static GLuint vao, vbo;
+static vector<GLfloat> vertices;    // x,y,z,r,g,b per vertex, kept between frames
+static float frametimes[HISTORY];
+static int framehead = 0;
+static long long lastframe = 0;
+static atomic<long long> ticktimes[64];    // written by the sim, which may have its own thread
+static int tickhead = 0;
+
+void hudInit ()
+{
+    MEM_SCOPE(MEM_HUD);
+    for (size_t i=0; i<sizeof(font)/sizeof(font[0]); i++) {
+        unsigned short mask = 0;
+        for (int b=0; b<15; b++)
+            if (font[i].rows[b] == '1')
+                mask |= 1 << b;
+        glyphs[(int)font[i].c] = mask;
+    }
+
+    // One interleaved buffer matching the scene shader's two attributes
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)(3*sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    vertices.reserve(6*6*2048);
+}
+
+void hudFrame ()
+{
+    long long now = profileNow();
+    if (lastframe)
+        frametimes[framehead] = (now - lastframe)/1e6;
+    framehead = (framehead + 1) % HISTORY;
+    lastframe = now;
+}
+
+void hudTick ()
+{
+    ticktimes[tickhead] = profileNow();
+    tickhead = (tickhead + 1) % 64;
+}
+
+/* Two triangles at depth 0 (z=1 under the overlay projection), so the
+   overlay passes GL_LEQUAL against the scene without touching depth state */
+static void quad (float x0, float y0, float x1, float y1, float r, float g, float b)
+{
+    const float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y0}, {x1, y1}, {x0, y1}};
+    for (int i=0; i<6; i++) {
+        GLfloat v[6] = {corners[i][0], corners[i][1], 1, r, g, b};
+        vertices.insert(vertices.end(), v, v+6);
+    }
+}
+
+/* Text with its top left corner at (x,y); each font pixel is 'size' wide.
+   Lit pixels next to each other in a row become a single quad. */
+static void text (float x, float y, const char* s, float size)
+{
+    for (; *s; s++, x += 4*size) {
+        unsigned short mask = glyphs[*s & 127];
+        for (int row=0; row<5; row++)
+            for (int col=0; col<3; col++) {
+                if (!(mask & 1 << (row*3 + col)))
+                    continue;
+                int end = col;
+                while (end+1 < 3 && (mask & 1 << (row*3 + end+1)))
+                    end++;
+                quad(x + col*size, y - (row+1)*size, x + (end+1)*size, y - row*size, 1, 1, 1);
+                col = end;
+            }
+    }
+}
+
+void hudDraw (GLuint matrix)
+{
+    PROFILE_SCOPE(PHASE_HUD);
+    MEM_SCOPE(MEM_HUD);
+    vertices.clear();
+    const float left = 10, top = HUD_HEIGHT - 10, size = 4, line = 7*size;
+    quad(left, top - 250, left + 400, top, 0.1f, 0.1f, 0.1f);
+
+    // Frame time graph, oldest on the left, with a line at 60 Hz
+    const float graph_top = top - 10, graph_bottom = graph_top - 70, bar = 360.0f/HISTORY;
+    float total = 0;
+    for (int i=0; i<HISTORY; i++) {
+        float ms = frametimes[(framehead + i) % HISTORY];
+        total += ms;
+        float h = (ms < GRAPH_MS ? ms : GRAPH_MS)/GRAPH_MS*(graph_top - graph_bottom);
+        // Green within a 60 Hz frame, yellow within 30 Hz, red beyond
+        float r = ms > 1000/60.0f + 1 ? 1 : 0.2f, g = ms > 1000/30.0f ? 0.2f : 1;
+        quad(left + 10 + i*bar, graph_bottom, left + 10 + (i+1)*bar - 1, graph_bottom + h, r, g, 0.2f);
+    }
+    float mark = graph_bottom + (1000/60.0f)/GRAPH_MS*(graph_top - graph_bottom);
+    quad(left + 10, mark, left + 370, mark + 1, 0.5f, 0.5f, 1);
+
+    long long now = profileNow();
+    int ticks = 0;
+    for (int i=0; i<64; i++)
+        ticks += ticktimes[i] && now - ticktimes[i] <= 1000000000LL;
+
+    char buffer[64];
+    float y = graph_bottom - 15;
+    snprintf(buffer, sizeof(buffer), "FRAME %.1f MS  AVG %.1f", frametimes[(framehead + HISTORY - 1) % HISTORY], total/HISTORY);
+    text(left + 10, y, buffer, size);
+    snprintf(buffer, sizeof(buffer), "TICKS/S %d", ticks);
+    text(left + 10, y -= line, buffer, size);
+    snprintf(buffer, sizeof(buffer), "DRAWS %ld  STATE %ld", renderstats.drawcalls, renderstats.statechanges);
+    text(left + 10, y -= line, buffer, size);
+    snprintf(buffer, sizeof(buffer), "TRIS %ld  CULLED %ld", renderstats.triangles, renderstats.culled);
+    text(left + 10, y -= line, buffer, size);
+    snprintf(buffer, sizeof(buffer), "GPU %.2f MS", gpuLastFrameTime()/1e6);
+    text(left + 10, y -= line, buffer, size);
+
+    glm::mat4 MVP = glm::ortho(0.0f, HUD_WIDTH, 0.0f, HUD_HEIGHT, -1.0f, 1.0f);
+    glUniformMatrix4fv(matrix, 1, GL_FALSE, &MVP[0][0]);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), &vertices[0], GL_STREAM_DRAW);
+    memGpuBuffer(vbo, vertices.size()*sizeof(GLfloat));
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size()/6);
+}
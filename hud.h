@@ -0,0 +1,28 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <glad/glad.h>
+
+/* What the scene cost to render this frame; reset at the start of draw() */
+struct RenderStats {
+    long drawcalls;
+    long statechanges;      // binds, enables, mode and uniform changes
+    long triangles;
+    long culled;            // tiles and obstacles left out of view
+};
+typedef struct RenderStats RenderStats;
+extern RenderStats renderstats;
+
+/* Performance overlay: frame time graph, sim ticks per second, the render
+   stats above and GPU time. The whole overlay is one vertex buffer upload
+   and one draw call with the scene's shader, drawn after the scene. */
+extern bool hudvisible;
+
+void hudInit ();
+void hudFrame ();       // once per frame, before hudDraw()
+void hudTick ();        // once per sim tick
+
+/* Expects the scene's program to be in use; 'matrix' is its MVP uniform */
+void hudDraw (GLuint matrix);
+
+#endif
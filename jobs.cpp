@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "jobs.h"
+
+using namespace std;
+
+struct Job {
+    JobCounter* counter;
+    ProfilePhase phase;
+    JobFunction fn;
+    void* arg;
+    int begin, end;
+};
+
+/* Queue 0 is shared by the threads that are not workers, worker w owns
+   queue w + 1. The owner pushes and takes at the tail, thieves take at the
+   head, each under the queue's own lock, which is only contended while a
+   steal is in progress. */
+const int MAX_WORKERS = 15;
+const int QUEUE_SIZE = 256;
+
+struct alignas(64) JobQueue {
+    mutex lock;
+    Job jobs[QUEUE_SIZE];
+    unsigned long head, tail;
+    atomic<long> ran, stolen;       // by the queue's own threads
+};
+
+static JobQueue queues[MAX_WORKERS + 1];
+static thread workers[MAX_WORKERS];
+static int nworkers = 0;
+static thread_local int self = 0;  // this thread's queue
+
+/* Idle workers sleep until a job is queued */
+static atomic<int> queued(0), sleepers(0);
+static atomic<bool> stopping(false);
+static mutex sleep_lock;
+static condition_variable wake;
+
+static bool takeTail (JobQueue& q, Job& job)
+{
+    lock_guard<mutex> guard(q.lock);
+    if (q.head == q.tail)
+        return false;
+    job = q.jobs[--q.tail % QUEUE_SIZE];
+    return true;
+}
+
+static bool takeHead (JobQueue& q, Job& job)
+{
+    lock_guard<mutex> guard(q.lock);
+    if (q.head == q.tail)
+        return false;
+    job = q.jobs[q.head++ % QUEUE_SIZE];
+    return true;
+}
+
+/* This thread's own newest job, else the oldest job of the shared queue
+   or, failing that, of the next worker along that has any */
+static bool take (Job& job)
+{
+    bool found = self ? takeTail(queues[self], job) : takeHead(queues[0], job);
+    for (int i=1; !found && i<=nworkers; i++) {
+        int victim = (self + i) % (nworkers + 1);
+        if (takeHead(queues[victim], job)) {
+            queues[self].stolen.fetch_add(1, memory_order_relaxed);
+            found = true;
+        }
+    }
+    if (found)
+        queued.fetch_sub(1);
+    return found;
+}
+
+static void run (const Job& job)
+{
+#ifndef NO_PROFILE
+    long long start = profileNow();
+#endif
+    job.fn(job.arg, job.begin, job.end);
+#ifndef NO_PROFILE
+    profileRecord(job.phase, start, profileNow());
+#endif
+    queues[self].ran.fetch_add(1, memory_order_relaxed);
+    job.counter->pending.fetch_sub(1, memory_order_release);
+}
+
+static void workerLoop (int queue)
+{
+    self = queue;
+    Job job;
+    while (!stopping.load()) {
+        if (take(job)) {
+            run(job);
+            continue;
+        }
+        unique_lock<mutex> guard(sleep_lock);
+        sleepers++;
+        wake.wait(guard, [] { return queued.load() > 0 || stopping.load(); });
+        sleepers--;
+    }
+}
+
+void jobsInit (int n)
+{
+    if (n == 0)
+        n = (int)thread::hardware_concurrency() - 1;
+    nworkers = max(0, min(n, MAX_WORKERS));
+    stopping = false;
+    for (int w=0; w<nworkers; w++)
+        workers[w] = thread(workerLoop, w + 1);
+}
+
+void jobsShutdown ()
+{
+    {
+        lock_guard<mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int w=0; w<nworkers; w++)
+        workers[w].join();
+    nworkers = 0;
+}
+
+int jobWorkers ()
+{
+    return nworkers;
+}
+
+void jobSubmit (JobCounter& counter, ProfilePhase phase, JobFunction fn, void* arg, int begin, int end)
+{
+    Job job = {&counter, phase, fn, arg, begin, end};
+    counter.pending.fetch_add(1, memory_order_relaxed);
+    // Counted before it can be taken, so 'queued' never drops below zero.
+    // Pairs with a worker counting itself asleep before it checks 'queued':
+    // either it sees the job or this sees it and waits until it can be woken.
+    queued.fetch_add(1);
+    JobQueue& q = queues[self];
+    {
+        lock_guard<mutex> guard(q.lock);
+        if (q.tail - q.head < QUEUE_SIZE) {
+            q.jobs[q.tail++ % QUEUE_SIZE] = job;
+            job.fn = NULL;
+        }
+    }
+    if (job.fn) {
+        queued.fetch_sub(1);
+        run(job);
+        return;
+    }
+    if (sleepers.load()) {
+        { lock_guard<mutex> guard(sleep_lock); }
+        wake.notify_one();
+    }
+}
+
+void jobWait (JobCounter& counter)
+{
+    Job job;
+    while (counter.pending.load(memory_order_acquire)) {
+        if (take(job))
+            run(job);
+        else
+            this_thread::yield();
+    }
+}
+
+void jobsReport (FILE* out)
+{
+    long ran = 0;
+    for (int q=0; q<=nworkers; q++)
+        ran += queues[q].ran.load();
+    if (!ran)
+        return;
+    fprintf(out, "%-18s %8s %8s\n", "jobs", "ran", "stolen");
+    for (int q=0; q<=nworkers; q++) {
+        char name[32];
+        snprintf(name, sizeof name, q ? "worker %d" : "other threads", q);
+        fprintf(out, "%-18s %8ld %8ld\n", name, queues[q].ran.load(), queues[q].stolen.load());
+    }
+}
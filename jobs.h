@@ -0,0 +1,65 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <cstdio>
+
+#include "profiler.h"
+
+/* A small work-stealing job system. Each worker thread has its own deque
+   of jobs: it takes its newest job first and, once out of work, steals
+   the oldest job of another queue. Threads that are not workers (the main
+   and sim threads) submit to a shared queue. A thread waiting on jobs runs
+   queued jobs itself in the meantime, so waiting never deadlocks, and with
+   no workers at all everything simply runs on the waiting thread.
+   Jobs are a function pointer and its argument, copied into fixed queues:
+   submitting never allocates. */
+
+/* Counts the unfinished jobs of a batch; jobWait() returns at zero */
+struct JobCounter {
+    std::atomic<int> pending;
+    JobCounter () : pending(0) {}
+};
+
+typedef void (*JobFunction) (void* arg, int begin, int end);
+
+/* Starts 'workers' threads, or one fewer than there are cores if 0 */
+void jobsInit (int workers=0);
+void jobsShutdown ();
+int jobWorkers ();
+
+/* Queues fn(arg, begin, end). The job's run time is recorded under
+   'phase' (see profiler.h) on whichever thread runs it, so traces show
+   each job on its worker. Runs the job at once if its queue is full. */
+void jobSubmit (JobCounter& counter, ProfilePhase phase, JobFunction fn, void* arg, int begin, int end);
+
+/* Runs queued jobs until all of the counter's jobs are done */
+void jobWait (JobCounter& counter);
+
+/* Jobs run and stolen per thread since jobsInit() */
+void jobsReport (FILE* out);
+
+template <class F>
+static void jobRunRange (void* f, int begin, int end)
+{
+    (*(F*)f)(begin, end);
+}
+
+/* Calls fn(begin, end) over [0, n) in chunks of at least 'grain' items,
+   spread over the workers, and returns once all are done. Fewer than two
+   chunks' worth runs right here, with no job at all. */
+template <class F>
+void parallelFor (int n, int grain, ProfilePhase phase, F fn)
+{
+    int chunks = n / grain;
+    if (chunks < 2 || jobWorkers() == 0) {
+        fn(0, n);
+        return;
+    }
+    JobCounter counter;
+    for (int c=0; c<chunks; c++)
+        jobSubmit(counter, phase, jobRunRange<F>, &fn, (long)n*c/chunks, (long)n*(c + 1)/chunks);
+    jobWait(counter);
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <atomic>
+
+#include "latency.h"
+#include "profiler.h"
+
+using namespace std;
+
+/* Inputs move through the stages in the order they arrived, so each stage
+   is just a count of how many inputs have passed it. The stamps live in a
+   ring; if more inputs than it holds are waiting, new ones are dropped.
+   'received' is how the input thread hands stamps to the sim; the rest is
+   touched by one thread only. */
+const int INFLIGHT = 64;
+
+struct InputStamp {
+    long long input, tick;
+};
+
+static InputStamp inflight[INFLIGHT];
+static atomic<unsigned long> received(0);
+static unsigned long consumed = 0;      // sim thread
+static unsigned long drawn = 0, presented = 0, dropped = 0;     // input and render thread
+
+/* 1 ms buckets; the last one holds everything slower */
+const int BUCKETS = 250;
+
+enum LatencyStage {
+    STAGE_INPUT_TO_TICK = 0,
+    STAGE_TICK_TO_PRESENT,
+    STAGE_INPUT_TO_PRESENT,
+    STAGE_COUNT
+};
+
+static const char* const stagenames[STAGE_COUNT] = {"input to tick", "tick to present", "input to present"};
+
+struct Histogram {
+    long buckets[BUCKETS];
+    long count;
+    long long max;
+};
+
+static Histogram histograms[STAGE_COUNT];
+
+static void add (LatencyStage stage, long long ns)
+{
+    Histogram& h = histograms[stage];
+    h.buckets[min((long long)BUCKETS - 1, ns/1000000)]++;
+    h.count++;
+    h.max = max(h.max, ns);
+}
+
+void latencyInput ()
+{
+    unsigned long n = received.load(memory_order_relaxed);
+    if (n - presented == INFLIGHT) {
+        dropped++;
+        return;
+    }
+    inflight[n % INFLIGHT].input = profileNow();
+    received.store(n + 1, memory_order_release);
+}
+
+unsigned long latencyTick ()
+{
+    long long now = profileNow();
+    for (unsigned long n = received.load(memory_order_acquire); consumed < n; consumed++)
+        inflight[consumed % INFLIGHT].tick = now;
+    return consumed;
+}
+
+void latencyFrame (unsigned long inputs)
+{
+    drawn = inputs;
+}
+
+void latencyPresent ()
+{
+    long long now = profileNow();
+    for (; presented < drawn; presented++) {
+        const InputStamp& s = inflight[presented % INFLIGHT];
+        add(STAGE_INPUT_TO_TICK, s.tick - s.input);
+        add(STAGE_TICK_TO_PRESENT, now - s.tick);
+        add(STAGE_INPUT_TO_PRESENT, now - s.input);
+    }
+}
+
+/* Upper edge of the bucket holding the p-th percentile, or the slowest
+   sample if that is lower */
+static double percentile (const Histogram& h, int p)
+{
+    long rank = (h.count*p + 99)/100, seen = 0;
+    int i = 0;
+    while (i < BUCKETS - 1 && (seen += h.buckets[i]) < rank)
+        i++;
+    return min((double)i + 1, h.max/1e6);
+}
+
+void latencyReport (FILE* out)
+{
+    if (!histograms[STAGE_INPUT_TO_PRESENT].count)
+        return;
+    fprintf(out, "%-18s %8s %6s %6s %6s %9s\n", "input latency (ms)", "samples", "p50", "p95", "p99", "max");
+    for (int s=0; s<STAGE_COUNT; s++) {
+        const Histogram& h = histograms[s];
+        fprintf(out, "%-18s %8ld %6.1f %6.1f %6.1f %9.3f\n", stagenames[s], h.count,
+                percentile(h, 50), percentile(h, 95), percentile(h, 99), h.max/1e6);
+    }
+    if (dropped)
+        fprintf(out, "%lu inputs not timed, more than %d were in flight\n", dropped, INFLIGHT);
+
+    // Input to present in 10 ms bins by their lower edge, bars scaled to the fullest bin
+    const Histogram& h = histograms[STAGE_INPUT_TO_PRESENT];
+    long bins[BUCKETS/10] = {0}, fullest = 1;
+    int last = 0;
+    for (int i=0; i<BUCKETS; i++)
+        if (h.buckets[i]) {
+            bins[i/10] += h.buckets[i];
+            fullest = max(fullest, bins[i/10]);
+            last = i/10;
+        }
+    for (int b=0; b<=last; b++) {
+        fprintf(out, "%5d ms%s %6ld ", 10*b, b == BUCKETS/10 - 1 ? "+" : " ", bins[b]);
+        for (long n=0; n < 50*bins[b]/fullest; n++)
+            fputc('#', out);
+        fputc('\n', out);
+    }
+}
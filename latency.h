@@ -0,0 +1,23 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cstdio>
+
+/* Input-to-photon latency. An input is stamped when its GLFW callback runs,
+   again when the sim tick that acts on it starts, and once more when the
+   swap of the first frame drawn after that tick returns. Callbacks run
+   inside glfwPollEvents(), so the time an event waited in the OS queue
+   before the poll is not seen, and the display's scan-out after the swap
+   is not either.
+   The callbacks and the sim may be on different threads: latencyTick()
+   returns how many inputs the sim has taken so far, and the frame drawn
+   from that tick's state passes the count on to latencyFrame(). */
+void latencyInput ();                   // from an input callback
+unsigned long latencyTick ();           // at the start of the sim tick that reads the input
+void latencyFrame (unsigned long inputs);   // before draw(), with the count of the tick drawn
+void latencyPresent ();                 // after glfwSwapBuffers() returns
+
+/* Percentiles and a histogram of each stage in milliseconds */
+void latencyReport (FILE* out);
+
+#endif
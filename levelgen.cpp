@@ -0,0 +1,163 @@
+#include "levelgen.h"
+
+using namespace std;
+
+void RollbackUnionFind::init (int n)
+{
+    parent.resize(n);
+    size.assign(n, 1);
+    history.clear();
+    for (int i=0; i<n; i++)
+        parent[i] = i;
+}
+
+int RollbackUnionFind::find (int a) const
+{
+    while (parent[a] != a)
+        a = parent[a];
+    return a;
+}
+
+bool RollbackUnionFind::unite (int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        history.push_back(-1);
+        return false;
+    }
+    if (size[a] < size[b])
+        swap(a, b);
+    parent[b] = a;
+    size[a] += size[b];
+    history.push_back(b);
+    return true;
+}
+
+void RollbackUnionFind::rollback (size_t mark)
+{
+    while (history.size() > mark) {
+        int b = history.back();
+        history.pop_back();
+        if (b == -1)
+            continue;
+        size[parent[b]] -= size[b];
+        parent[b] = b;
+    }
+}
+
+/* State of one placeHazards() call */
+struct HazardPlacer {
+    const Grid& grid;
+    const vector<HazardCandidate>& candidates;
+    vector<int> order;              // candidates that can change connectivity
+    int start, goal;
+    RollbackUnionFind sets;
+    vector<unsigned char> open;     // cells currently joined into 'sets'
+    vector<int> opened;             // cells opened, for undo
+    vector<char> verdict;
+
+    HazardPlacer (const Grid& g, const vector<HazardCandidate>& c, int s, int t)
+        : grid(g), candidates(c), start(s), goal(t) {}
+
+    void openCell (int cell)
+    {
+        static const int dx[4] = {1, -1, 0, 0};
+        static const int dz[4] = {0, 0, 1, -1};
+        open[cell] = 1;
+        opened.push_back(cell);
+        int cx = cellX(grid, cell), cz = cellZ(grid, cell);
+        for (int d=0; d<4; d++) {
+            int nx = cx + dx[d], nz = cz + dz[d];
+            if (nx < 0 || nz < 0 || nx >= grid.width || nz >= grid.height)
+                continue;
+            int next = cellIndex(grid, nx, nz);
+            if (open[next])
+                sets.unite(cell, next);
+        }
+    }
+
+    void undo (size_t sets_mark, size_t open_mark)
+    {
+        sets.rollback(sets_mark);
+        while (opened.size() > open_mark) {
+            open[opened.back()] = 0;
+            opened.pop_back();
+        }
+    }
+
+    /* On entry every candidate after 'r' is open, and of those before 'l'
+       exactly the rejected ones */
+    void solve (int l, int r)
+    {
+        if (r - l == 1) {
+            // Blocking this one is fine if the rest still connects
+            verdict[order[l]] = sets.connected(start, goal);
+            return;
+        }
+        int mid = (l + r)/2;
+        size_t sets_mark = sets.snapshot(), open_mark = opened.size();
+        for (int i=mid; i<r; i++)
+            openCell(candidates[order[i]].cell);
+        solve(l, mid);
+        undo(sets_mark, open_mark);
+        for (int i=l; i<mid; i++)
+            if (!verdict[order[i]])
+                openCell(candidates[order[i]].cell);
+        solve(mid, r);
+        undo(sets_mark, open_mark);
+    }
+};
+
+int placeHazards (Grid& grid, int start, int goal, const vector<HazardCandidate>& candidates, vector<char>* accepted)
+{
+    HazardPlacer placer(grid, candidates, start, goal);
+    int cells = grid.width*grid.height;
+    placer.verdict.assign(candidates.size(), 0);
+
+    // Walkable hazards always go in. Of the blocking ones only the first on
+    // an open cell other than the ends matters; hazards on cells that are
+    // already blocked can't cut anything off. A later one on the same cell
+    // finds it blocked if and only if the first went in.
+    vector<int> first(cells, -1);
+    vector<int> repeats;
+    for (size_t i=0; i<candidates.size(); i++) {
+        int cell = candidates[i].cell;
+        if (candidates[i].tile == TILE_FLOOR || candidates[i].tile == TILE_PILE) {
+            placer.verdict[i] = 1;
+            continue;
+        }
+        if (cell == start || cell == goal)
+            continue;
+        if (first[cell] != -1) {
+            repeats.push_back(i);
+            continue;
+        }
+        first[cell] = i;
+        if (isWalkable(grid, cell))
+            placer.order.push_back(i);
+        else
+            placer.verdict[i] = 1;
+    }
+
+    placer.sets.init(cells);
+    placer.open.assign(cells, 0);
+    for (int cell=0; cell<cells; cell++)
+        if (isWalkable(grid, cell) && first[cell] == -1)
+            placer.openCell(cell);
+    placer.opened.clear();
+    if (!placer.order.empty())
+        placer.solve(0, placer.order.size());
+    for (size_t i=0; i<repeats.size(); i++)
+        placer.verdict[repeats[i]] = placer.verdict[first[candidates[repeats[i]].cell]];
+
+    int placed = 0;
+    for (size_t i=0; i<candidates.size(); i++)
+        if (placer.verdict[i]) {
+            grid.tiles[candidates[i].cell] = candidates[i].tile;
+            placed++;
+        }
+    if (accepted)
+        *accepted = placer.verdict;
+    return placed;
+}
@@ -0,0 +1,46 @@
+#ifndef LEVELGEN_H
+#define LEVELGEN_H
+
+#include <cstddef>
+#include <vector>
+
+#include "maze.h"
+
+/* Disjoint sets with undo. Union by size without path compression keeps
+   every union a single pointer change, so it can be reverted exactly. */
+struct RollbackUnionFind {
+    std::vector<int> parent, size;
+    std::vector<int> history;   // root attached by each union, -1 for a no-op
+
+    void init (int n);
+    int find (int a) const;
+    bool unite (int a, int b);
+    bool connected (int a, int b) const { return find(a) == find(b); }
+
+    size_t snapshot () const { return history.size(); }
+    void rollback (size_t mark);
+};
+typedef struct RollbackUnionFind RollbackUnionFind;
+
+/* A hazard the generator would like to put on a cell */
+struct HazardCandidate {
+    int cell;
+    TileType tile;
+};
+typedef struct HazardCandidate HazardCandidate;
+
+/* Place the blocking candidates in order, turning down any that would cut
+   'start' off from 'goal' given the ones already accepted (candidates not
+   yet decided count as open). Accepted hazards are written into the grid;
+   'accepted', when given, receives the verdict per candidate. Returns the
+   number placed.
+
+   The placer is offline and works on a batch only: it needs the whole
+   candidate list before it can give any verdict, so a generator can not
+   ask about one placement at a time. Each candidate is joined into a
+   rollback union-find O(log n) times by a divide and conquer over the
+   candidate sequence, so a verdict costs O(log^2 n) amortised instead of
+   a search over the whole field. */
+int placeHazards (Grid& grid, int start, int goal, const std::vector<HazardCandidate>& candidates, std::vector<char>* accepted=NULL);
+
+#endif
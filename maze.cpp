@@ -0,0 +1,77 @@
+#include <cmath>
+#include <random>
+
+#include "maze.h"
+
+using namespace std;
+
+void initGrid (Grid& grid, int width, int height, int origin_x, int origin_z, TileType fill)
+{
+    grid.width = width;
+    grid.height = height;
+    grid.origin_x = origin_x;
+    grid.origin_z = origin_z;
+    grid.tiles.assign((size_t)width*height, (unsigned char)fill);
+}
+
+int worldToCell (const Grid& grid, float x, float z)
+{
+    int cx = (int)floor(x + 0.5f) - grid.origin_x;
+    int cz = (int)floor(z + 0.5f) - grid.origin_z;
+    if (cx < 0 || cz < 0 || cx >= grid.width || cz >= grid.height)
+        return -1;
+    return cellIndex(grid, cx, cz);
+}
+
+void generateMaze (Grid& grid, int width, int height, unsigned int seed, float braid)
+{
+    initGrid(grid, width, height, 0, 0, TILE_OBSTACLE);
+    mt19937 rng(seed);
+
+    // Rooms sit on odd coordinates, walls in between
+    static const int dx[4] = {2, -2, 0, 0};
+    static const int dz[4] = {0, 0, 2, -2};
+    vector<int> stack;
+    stack.push_back(cellIndex(grid, 1, 1));
+    grid.tiles[stack.back()] = TILE_FLOOR;
+    while (!stack.empty()) {
+        int cell = stack.back();
+        int cx = cellX(grid, cell), cz = cellZ(grid, cell);
+        int options[4], n = 0;
+        for (int d=0; d<4; d++) {
+            int nx = cx + dx[d], nz = cz + dz[d];
+            if (nx > 0 && nz > 0 && nx < width-1 && nz < height-1 && grid.tiles[cellIndex(grid, nx, nz)] == TILE_OBSTACLE)
+                options[n++] = d;
+        }
+        if (n == 0) {
+            stack.pop_back();
+            continue;
+        }
+        int d = options[rng() % n];
+        grid.tiles[cellIndex(grid, cx + dx[d]/2, cz + dz[d]/2)] = TILE_FLOOR;
+        grid.tiles[cellIndex(grid, cx + dx[d], cz + dz[d])] = TILE_FLOOR;
+        stack.push_back(cellIndex(grid, cx + dx[d], cz + dz[d]));
+    }
+
+    if (braid <= 0)
+        return;
+    uniform_real_distribution<float> chance(0, 1);
+    for (int cz=1; cz<height-1; cz++)
+        for (int cx=1; cx<width-1; cx++) {
+            // Only walls separating two rooms in a straight line
+            if ((cx + cz) % 2 == 0 || grid.tiles[cellIndex(grid, cx, cz)] != TILE_OBSTACLE)
+                continue;
+            if (chance(rng) < braid)
+                grid.tiles[cellIndex(grid, cx, cz)] = TILE_FLOOR;
+        }
+}
+
+void generateScatter (Grid& grid, int width, int height, unsigned int seed, float density)
+{
+    initGrid(grid, width, height, 0, 0, TILE_FLOOR);
+    mt19937 rng(seed);
+    uniform_real_distribution<float> chance(0, 1);
+    for (size_t i=0; i<grid.tiles.size(); i++)
+        if (chance(rng) < density)
+            grid.tiles[i] = TILE_OBSTACLE;
+}
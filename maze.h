@@ -0,0 +1,52 @@
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <vector>
+
+/* Contents of a single tile of the playing field */
+enum TileType {
+    TILE_FLOOR = 0,     // plain walkable tile
+    TILE_PIT,           // hole in the field, the player falls through
+    TILE_OBSTACLE,      // static block, only passable by jumping
+    TILE_PILE           // moving pile, blocks only while raised
+};
+
+/* Rectangular tile field. Cell (cx,cz) covers the unit square centred
+   on world position (origin_x+cx, origin_z+cz). */
+struct Grid {
+    int width, height;
+    int origin_x, origin_z;
+    std::vector<unsigned char> tiles;
+};
+typedef struct Grid Grid;
+
+void initGrid (Grid& grid, int width, int height, int origin_x, int origin_z, TileType fill=TILE_FLOOR);
+
+/* Cell index of the tile under world position (x,z), -1 when outside the field */
+int worldToCell (const Grid& grid, float x, float z);
+
+inline int cellIndex (const Grid& grid, int cx, int cz) { return cz*grid.width + cx; }
+inline int cellX (const Grid& grid, int cell) { return cell % grid.width; }
+inline int cellZ (const Grid& grid, int cell) { return cell / grid.width; }
+
+/* Piles are walkable for static queries: they only block while raised */
+inline bool isWalkable (const Grid& grid, int cell)
+{
+    unsigned char tile = grid.tiles[cell];
+    return tile == TILE_FLOOR || tile == TILE_PILE;
+}
+
+inline bool isWalkable (const Grid& grid, int cx, int cz)
+{
+    return cx >= 0 && cz >= 0 && cx < grid.width && cz < grid.height && isWalkable(grid, cellIndex(grid, cx, cz));
+}
+
+/* Perfect maze carved with an iterative backtracker on odd cells; walls are
+   obstacles. 'braid' in [0,1] knocks out that fraction of the remaining
+   inner walls so the maze has loops. */
+void generateMaze (Grid& grid, int width, int height, unsigned int seed, float braid=0);
+
+/* Open field with obstacles scattered at the given density */
+void generateScatter (Grid& grid, int width, int height, unsigned int seed, float density);
+
+#endif
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+
+#include "memtrack.h"
+
+using namespace std;
+
+const char* const memCategoryNames[MEM_CATEGORY_COUNT] = {
+    "other", "meshes", "instances", "levels", "shaders", "hud", "capture",
+};
+
+/* Live bytes and high-water marks; index MEM_CATEGORY_COUNT is the total */
+struct MemCounters {
+    atomic<long long> live[MEM_CATEGORY_COUNT + 1];
+    atomic<long long> peak[MEM_CATEGORY_COUNT + 1];
+};
+
+static MemCounters cpu, gpu;
+static thread_local MemCategory current = MEM_OTHER;
+static thread_local bool background = false;
+
+static atomic<bool> inloop(false);
+static atomic<long> frames(-1), firstframe(-1);
+static atomic<long> loopallocs[MEM_CATEGORY_COUNT], warmupallocs(0);
+static atomic<long long> loopbytes(0);
+
+static void raisePeak (atomic<long long>& peak, long long value)
+{
+    long long seen = peak.load(memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, memory_order_relaxed))
+        ;
+}
+
+static void charge (MemCounters& c, int category, long long bytes)
+{
+    raisePeak(c.peak[category], c.live[category].fetch_add(bytes, memory_order_relaxed) + bytes);
+    raisePeak(c.peak[MEM_CATEGORY_COUNT], c.live[MEM_CATEGORY_COUNT].fetch_add(bytes, memory_order_relaxed) + bytes);
+}
+
+MemScope::MemScope (MemCategory category) : saved(current)
+{
+    current = category;
+}
+
+MemScope::~MemScope ()
+{
+    current = saved;
+}
+
+/* Each block starts with a header holding its size and category, padded
+   so the memory handed out keeps malloc's alignment */
+struct alignas(alignof(max_align_t)) MemHeader {
+    size_t size;
+    int category;
+};
+
+static void* allocate (size_t size)
+{
+    MemHeader* h = (MemHeader*)malloc(sizeof(MemHeader) + size);
+    if (!h)
+        return NULL;
+    h->size = size;
+    h->category = current;
+    charge(cpu, current, size);
+    if (inloop.load(memory_order_relaxed) && !background) {
+        long frame = frames.load(memory_order_relaxed), none = -1;
+        if (frame == 0) {
+            warmupallocs.fetch_add(1, memory_order_relaxed);
+            return h + 1;
+        }
+        firstframe.compare_exchange_strong(none, frame, memory_order_relaxed);
+        loopallocs[current].fetch_add(1, memory_order_relaxed);
+        loopbytes.fetch_add(size, memory_order_relaxed);
+    }
+    return h + 1;
+}
+
+static void release (void* p)
+{
+    if (!p)
+        return;
+    MemHeader* h = (MemHeader*)p - 1;
+    charge(cpu, h->category, -(long long)h->size);
+    free(h);
+}
+
+void* operator new (size_t size)
+{
+    void* p = allocate(size);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
+
+void* operator new[] (size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new (size_t size, const nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[] (size_t size, const nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete (void* p) noexcept { release(p); }
+void operator delete[] (void* p) noexcept { release(p); }
+void operator delete (void* p, size_t) noexcept { release(p); }
+void operator delete[] (void* p, size_t) noexcept { release(p); }
+void operator delete (void* p, const nothrow_t&) noexcept { release(p); }
+void operator delete[] (void* p, const nothrow_t&) noexcept { release(p); }
+
+/* Size and category of every live GL buffer */
+static mutex gpu_lock;
+static map<unsigned int, pair<long, MemCategory> > buffers;
+
+void memGpuBuffer (unsigned int buffer, long bytes)
+{
+    lock_guard<mutex> guard(gpu_lock);
+    pair<long, MemCategory>& b = buffers[buffer];
+    if (b.first)
+        charge(gpu, b.second, -b.first);
+    b = make_pair(bytes, current);
+    charge(gpu, current, bytes);
+}
+
+void memGpuFree (unsigned int buffer)
+{
+    lock_guard<mutex> guard(gpu_lock);
+    map<unsigned int, pair<long, MemCategory> >::iterator it = buffers.find(buffer);
+    if (it == buffers.end())
+        return;
+    charge(gpu, it->second.second, -it->second.first);
+    buffers.erase(it);
+}
+
+void memBackgroundThread ()
+{
+    background = true;
+}
+
+void memFrame ()
+{
+    frames.fetch_add(1, memory_order_relaxed);
+    inloop.store(true);
+}
+
+void memLoopEnd ()
+{
+    inloop.store(false);
+}
+
+long memLoopAllocations ()
+{
+    long n = 0;
+    for (int c=0; c<MEM_CATEGORY_COUNT; c++)
+        n += loopallocs[c].load();
+    return n;
+}
+
+void memReport (FILE* out)
+{
+    fprintf(out, "%-18s %10s %10s %10s %10s\n", "memory (KB)", "cpu", "cpu peak", "gpu", "gpu peak");
+    for (int c=0; c<=MEM_CATEGORY_COUNT; c++)
+        fprintf(out, "%-18s %10.1f %10.1f %10.1f %10.1f\n", c < MEM_CATEGORY_COUNT ? memCategoryNames[c] : "total",
+                cpu.live[c].load()/1024.0, cpu.peak[c].load()/1024.0, gpu.live[c].load()/1024.0, gpu.peak[c].load()/1024.0);
+
+    long n = memLoopAllocations();
+    fprintf(out, "frame loop: %ld allocations, %lld bytes over %ld frames after the first", n, loopbytes.load(), max(frames.load(), 0L));
+    if (n) {
+        fprintf(out, ", first in frame %ld:", firstframe.load());
+        for (int c=0; c<MEM_CATEGORY_COUNT; c++)
+            if (loopallocs[c].load())
+                fprintf(out, " %s %ld", memCategoryNames[c], loopallocs[c].load());
+    }
+    fprintf(out, "\n");
+    if (warmupallocs.load())
+        fprintf(out, "first frame: %ld allocations, not counted\n", warmupallocs.load());
+}
@@ -0,0 +1,55 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <cstdio>
+
+/* What memory is for. CPU allocations are charged to the category of the
+   innermost MEM_SCOPE on the allocating thread, GL buffers to the one
+   current when they are sized. */
+enum MemCategory {
+    MEM_OTHER = 0,
+    MEM_MESHES,             // the player and other one-off models
+    MEM_INSTANCES,          // per-tile models: tiles and obstacles
+    MEM_LEVELS,             // the level grid and its goal field
+    MEM_SHADERS,            // shader sources and build logs
+    MEM_HUD,
+    MEM_CAPTURE,            // frame capture's readback buffers
+    MEM_CATEGORY_COUNT
+};
+
+extern const char* const memCategoryNames[MEM_CATEGORY_COUNT];
+
+/* Charges the enclosing block's allocations to 'category' */
+struct MemScope {
+    MemCategory saved;
+    MemScope (MemCategory category);
+    ~MemScope ();
+};
+#define MEM_JOIN2(a, b) a##b
+#define MEM_JOIN(a, b) MEM_JOIN2(a, b)
+#define MEM_SCOPE(category) MemScope MEM_JOIN(mem_scope_, __LINE__)(category)
+
+/* Bytes now held by GL buffer 'buffer' (after glBufferData), and its
+   deletion. Re-sizing a buffer replaces its old size. */
+void memGpuBuffer (unsigned int buffer, long bytes);
+void memGpuFree (unsigned int buffer);
+
+/* Every C++ allocation in the process goes through the counting operator
+   new, the GL driver's included. From the second memFrame() until
+   memLoopEnd(), allocations are also counted as frame-loop allocations,
+   which a steady frame should not make. The first frame is left out as
+   drivers finish building state at the first draw. Memory malloc()ed by
+   C code is not seen. */
+void memFrame ();           // at the top of every frame
+void memLoopEnd ();
+long memLoopAllocations ();
+
+/* Leaves the calling thread's allocations out of the frame loop's, for a
+   thread that loads in the background and that no frame waits on */
+void memBackgroundThread ();
+
+/* Live bytes and high-water marks per category, and the frame loop's
+   allocations */
+void memReport (FILE* out);
+
+#endif
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#include "pathfinding.h"
+#include "piles.h"
+#include "jobs.h"
+
+using namespace std;
+
+/* Per-thread search state, reused between queries. Cells are marked with a
+   generation stamp so nothing has to be cleared between searches. */
+struct SearchScratch {
+    vector<unsigned int> seen, closed;
+    vector<int> g, parent;
+    vector<int> queue;
+    unsigned int gen;
+
+    void begin (size_t cells)
+    {
+        if (seen.size() != cells || gen == ~0u) {
+            seen.assign(cells, 0);
+            closed.assign(cells, 0);
+            g.resize(cells);
+            parent.resize(cells);
+            gen = 0;
+        }
+        gen++;
+    }
+};
+static thread_local SearchScratch scratch;
+static thread_local SearchScratch timed;     // indexed by cell*PILE_PERIOD + phase
+
+struct OpenNode {
+    int f, g, cell;
+};
+
+/* Min-heap on f, preferring deeper nodes on ties */
+struct OpenOrder {
+    bool operator() (const OpenNode& a, const OpenNode& b) const
+    {
+        return a.f > b.f || (a.f == b.f && a.g < b.g);
+    }
+};
+
+static int manhattan (const Grid& grid, int a, int b)
+{
+    return abs(cellX(grid, a) - cellX(grid, b)) + abs(cellZ(grid, a) - cellZ(grid, b));
+}
+
+static bool validEnds (const Grid& grid, int start, int goal)
+{
+    int cells = grid.width*grid.height;
+    return start >= 0 && goal >= 0 && start < cells && goal < cells
+        && isWalkable(grid, start) && isWalkable(grid, goal);
+}
+
+/* Walk parents back from the goal, filling in the straight runs between
+   jump points (a no-op for searches that link neighbouring cells) */
+static void buildPath (const Grid& grid, int goal, vector<int>& path)
+{
+    path.clear();
+    for (int cell = goal; cell != -1; cell = scratch.parent[cell]) {
+        int prev = scratch.parent[cell];
+        path.push_back(cell);
+        if (prev == -1)
+            break;
+        int dx = cellX(grid, prev) - cellX(grid, cell), dz = cellZ(grid, prev) - cellZ(grid, cell);
+        int step = (dx > 0) - (dx < 0) + ((dz > 0) - (dz < 0))*grid.width;
+        for (int c = cell + step; c != prev; c += step)
+            path.push_back(c);
+    }
+    reverse(path.begin(), path.end());
+}
+
+bool findPathBFS (const Grid& grid, int start, int goal, vector<int>& path, PathStats* stats)
+{
+    path.clear();
+    if (stats)
+        stats->expanded = stats->touched = 0;
+    if (!validEnds(grid, start, goal))
+        return false;
+
+    static const int dx[4] = {1, -1, 0, 0};
+    static const int dz[4] = {0, 0, 1, -1};
+    scratch.begin(grid.tiles.size());
+    vector<int>& queue = scratch.queue;
+    queue.clear();
+    queue.push_back(start);
+    scratch.seen[start] = scratch.gen;
+    scratch.parent[start] = -1;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int cell = queue[head];
+        if (stats)
+            stats->expanded++;
+        if (cell == goal) {
+            buildPath(grid, goal, path);
+            return true;
+        }
+        int cx = cellX(grid, cell), cz = cellZ(grid, cell);
+        for (int d=0; d<4; d++) {
+            if (!isWalkable(grid, cx + dx[d], cz + dz[d]))
+                continue;
+            int next = cellIndex(grid, cx + dx[d], cz + dz[d]);
+            if (stats)
+                stats->touched++;
+            if (scratch.seen[next] == scratch.gen)
+                continue;
+            scratch.seen[next] = scratch.gen;
+            scratch.parent[next] = cell;
+            queue.push_back(next);
+        }
+    }
+    return false;
+}
+
+bool findPathAStar (const Grid& grid, int start, int goal, vector<int>& path, PathStats* stats)
+{
+    path.clear();
+    if (stats)
+        stats->expanded = stats->touched = 0;
+    if (!validEnds(grid, start, goal))
+        return false;
+
+    static const int dx[4] = {1, -1, 0, 0};
+    static const int dz[4] = {0, 0, 1, -1};
+    scratch.begin(grid.tiles.size());
+    vector<OpenNode> open;
+    OpenNode first = {manhattan(grid, start, goal), 0, start};
+    open.push_back(first);
+    scratch.seen[start] = scratch.gen;
+    scratch.g[start] = 0;
+    scratch.parent[start] = -1;
+    while (!open.empty()) {
+        pop_heap(open.begin(), open.end(), OpenOrder());
+        OpenNode node = open.back();
+        open.pop_back();
+        if (scratch.closed[node.cell] == scratch.gen || node.g != scratch.g[node.cell])
+            continue;
+        scratch.closed[node.cell] = scratch.gen;
+        if (stats)
+            stats->expanded++;
+        if (node.cell == goal) {
+            buildPath(grid, goal, path);
+            return true;
+        }
+        int cx = cellX(grid, node.cell), cz = cellZ(grid, node.cell);
+        for (int d=0; d<4; d++) {
+            if (!isWalkable(grid, cx + dx[d], cz + dz[d]))
+                continue;
+            int next = cellIndex(grid, cx + dx[d], cz + dz[d]);
+            int g = node.g + 1;
+            if (stats)
+                stats->touched++;
+            if (scratch.seen[next] == scratch.gen && scratch.g[next] <= g)
+                continue;
+            scratch.seen[next] = scratch.gen;
+            scratch.g[next] = g;
+            scratch.parent[next] = node.cell;
+            OpenNode succ = {g + manhattan(grid, next, goal), g, next};
+            open.push_back(succ);
+            push_heap(open.begin(), open.end(), OpenOrder());
+        }
+    }
+    return false;
+}
+
+/* Jump points on a 4-connected grid, using "vertical first" as the canonical
+   order of equal-length paths. A horizontal run stops where a vertical
+   neighbour opens up behind a wall; a vertical run stops wherever a
+   horizontal run from it would find something. */
+static int jumpHorizontal (const Grid& grid, int cx, int cz, int dx, int goal, PathStats* stats)
+{
+    for (;;) {
+        cx += dx;
+        if (!isWalkable(grid, cx, cz))
+            return -1;
+        if (stats)
+            stats->touched++;
+        int cell = cellIndex(grid, cx, cz);
+        if (cell == goal)
+            return cell;
+        if ((isWalkable(grid, cx, cz-1) && !isWalkable(grid, cx-dx, cz-1))
+            || (isWalkable(grid, cx, cz+1) && !isWalkable(grid, cx-dx, cz+1)))
+            return cell;
+    }
+}
+
+static int jumpVertical (const Grid& grid, int cx, int cz, int dz, int goal, PathStats* stats)
+{
+    for (;;) {
+        cz += dz;
+        if (!isWalkable(grid, cx, cz))
+            return -1;
+        if (stats)
+            stats->touched++;
+        int cell = cellIndex(grid, cx, cz);
+        if (cell == goal)
+            return cell;
+        if (jumpHorizontal(grid, cx, cz, 1, goal, stats) != -1 || jumpHorizontal(grid, cx, cz, -1, goal, stats) != -1)
+            return cell;
+    }
+}
+
+bool findPathJPS (const Grid& grid, int start, int goal, vector<int>& path, PathStats* stats)
+{
+    path.clear();
+    if (stats)
+        stats->expanded = stats->touched = 0;
+    if (!validEnds(grid, start, goal))
+        return false;
+
+    scratch.begin(grid.tiles.size());
+    vector<OpenNode> open;
+    OpenNode first = {manhattan(grid, start, goal), 0, start};
+    open.push_back(first);
+    scratch.seen[start] = scratch.gen;
+    scratch.g[start] = 0;
+    scratch.parent[start] = -1;
+    while (!open.empty()) {
+        pop_heap(open.begin(), open.end(), OpenOrder());
+        OpenNode node = open.back();
+        open.pop_back();
+        if (scratch.closed[node.cell] == scratch.gen || node.g != scratch.g[node.cell])
+            continue;
+        scratch.closed[node.cell] = scratch.gen;
+        if (stats)
+            stats->expanded++;
+        if (node.cell == goal) {
+            buildPath(grid, goal, path);
+            return true;
+        }
+
+        // Prune successors by the direction we arrived from
+        int cx = cellX(grid, node.cell), cz = cellZ(grid, node.cell);
+        int parent = scratch.parent[node.cell];
+        int pdx = 0, pdz = 0;
+        if (parent != -1) {
+            pdx = (cx > cellX(grid, parent)) - (cx < cellX(grid, parent));
+            pdz = (cz > cellZ(grid, parent)) - (cz < cellZ(grid, parent));
+        }
+        int jumps[4], n = 0;
+        if (parent == -1) {
+            jumps[n++] = jumpHorizontal(grid, cx, cz, 1, goal, stats);
+            jumps[n++] = jumpHorizontal(grid, cx, cz, -1, goal, stats);
+            jumps[n++] = jumpVertical(grid, cx, cz, 1, goal, stats);
+            jumps[n++] = jumpVertical(grid, cx, cz, -1, goal, stats);
+        }
+        else if (pdx != 0) {
+            jumps[n++] = jumpHorizontal(grid, cx, cz, pdx, goal, stats);
+            for (int dz=-1; dz<=1; dz+=2)
+                if (isWalkable(grid, cx, cz+dz) && !isWalkable(grid, cx-pdx, cz+dz))
+                    jumps[n++] = jumpVertical(grid, cx, cz, dz, goal, stats);
+        }
+        else {
+            jumps[n++] = jumpVertical(grid, cx, cz, pdz, goal, stats);
+            jumps[n++] = jumpHorizontal(grid, cx, cz, 1, goal, stats);
+            jumps[n++] = jumpHorizontal(grid, cx, cz, -1, goal, stats);
+        }
+
+        for (int i=0; i<n; i++) {
+            int next = jumps[i];
+            if (next == -1)
+                continue;
+            int g = node.g + manhattan(grid, node.cell, next);
+            if (scratch.seen[next] == scratch.gen && scratch.g[next] <= g)
+                continue;
+            scratch.seen[next] = scratch.gen;
+            scratch.g[next] = g;
+            scratch.parent[next] = node.cell;
+            OpenNode succ = {g + manhattan(grid, next, goal), g, next};
+            open.push_back(succ);
+            push_heap(open.begin(), open.end(), OpenOrder());
+        }
+    }
+    return false;
+}
+
+/* A few queries per job: one JPS query on a small grid costs about as
+   much as handing a job to another thread */
+const int PATH_GRAIN = 4;
+
+int findPathsJPS (const Grid& grid, const vector<PathQuery>& queries, vector<vector<int> >& paths)
+{
+    paths.resize(queries.size());
+    atomic<int> found(0);
+    parallelFor((int)queries.size(), PATH_GRAIN, PHASE_PATH_JOB, [&] (int begin, int end) {
+        int n = 0;
+        for (int q=begin; q<end; q++)
+            n += findPathJPS(grid, queries[q].start, queries[q].goal, paths[q]);
+        found += n;
+    });
+    return found;
+}
+
+/* Is 'cell' free of a raised pile at every tick in [from, to] */
+static bool clearDuring (const Grid& grid, int cell, long from, long to)
+{
+    if (grid.tiles[cell] != TILE_PILE)
+        return true;
+    for (long tick = from; tick <= to; tick++)
+        if (pileRaised(tick))
+            return false;
+    return true;
+}
+
+bool findPathSpaceTime (const Grid& grid, int start, int goal, long start_tick, int ticks_per_cell, long max_ticks,
+                        vector<TimedStep>& path, PathStats* stats)
+{
+    path.clear();
+    if (stats)
+        stats->expanded = stats->touched = 0;
+    if (!validEnds(grid, start, goal))
+        return false;
+    if (ticks_per_cell < 1)
+        ticks_per_cell = 1;
+
+    static const int dx[4] = {1, -1, 0, 0};
+    static const int dz[4] = {0, 0, 1, -1};
+    timed.begin(grid.tiles.size()*PILE_PERIOD);
+    vector<OpenNode> open;
+    int first = start*PILE_PERIOD + start_tick % PILE_PERIOD;
+    OpenNode root = {manhattan(grid, start, goal)*ticks_per_cell, 0, first};
+    open.push_back(root);
+    timed.seen[first] = timed.gen;
+    timed.g[first] = 0;
+    timed.parent[first] = -1;
+    while (!open.empty()) {
+        pop_heap(open.begin(), open.end(), OpenOrder());
+        OpenNode node = open.back();
+        open.pop_back();
+        if (timed.closed[node.cell] == timed.gen || node.g != timed.g[node.cell])
+            continue;
+        timed.closed[node.cell] = timed.gen;
+        if (stats)
+            stats->expanded++;
+
+        int cell = node.cell / PILE_PERIOD;
+        long tick = start_tick + node.g;
+        if (cell == goal) {
+            for (int state = node.cell; state != -1; state = timed.parent[state]) {
+                TimedStep step = {state / PILE_PERIOD, start_tick + timed.g[state]};
+                path.push_back(step);
+            }
+            reverse(path.begin(), path.end());
+            return true;
+        }
+
+        // Waiting in place, then moving to each neighbour
+        int targets[5], costs[5], n = 0;
+        targets[n] = cell;
+        costs[n++] = 1;
+        int cx = cellX(grid, cell), cz = cellZ(grid, cell);
+        for (int d=0; d<4; d++)
+            if (isWalkable(grid, cx + dx[d], cz + dz[d])) {
+                targets[n] = cellIndex(grid, cx + dx[d], cz + dz[d]);
+                costs[n++] = ticks_per_cell;
+            }
+        for (int i=0; i<n; i++) {
+            int g = node.g + costs[i];
+            if (stats)
+                stats->touched++;
+            if (g > max_ticks || !clearDuring(grid, targets[i], tick + 1, tick + costs[i]))
+                continue;
+            int state = targets[i]*PILE_PERIOD + (start_tick + g) % PILE_PERIOD;
+            if (timed.seen[state] == timed.gen && timed.g[state] <= g)
+                continue;
+            timed.seen[state] = timed.gen;
+            timed.g[state] = g;
+            timed.parent[state] = node.cell;
+            OpenNode succ = {g + manhattan(grid, targets[i], goal)*ticks_per_cell, g, state};
+            open.push_back(succ);
+            push_heap(open.begin(), open.end(), OpenOrder());
+        }
+    }
+    return false;
+}
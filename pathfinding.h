@@ -0,0 +1,56 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include <cstddef>
+#include <vector>
+
+#include "maze.h"
+
+/* Work done by a single query, for benchmarks */
+struct PathStats {
+    long expanded;      // nodes taken off the open list
+    long touched;       // cells inspected while scanning or relaxing
+};
+typedef struct PathStats PathStats;
+
+/* All searches walk the 4-connected grid of isWalkable() cells and return the
+   shortest path from 'start' to 'goal' as cell indices, both ends included.
+   They return false (and leave 'path' empty) when the goal is unreachable. */
+bool findPathBFS (const Grid& grid, int start, int goal, std::vector<int>& path, PathStats* stats=NULL);
+bool findPathAStar (const Grid& grid, int start, int goal, std::vector<int>& path, PathStats* stats=NULL);
+
+/* Jump point search for 4-connected grids: straight runs without forced
+   neighbours are skipped instead of pushed, so open corridors cost a scan
+   rather than a heap operation per cell. */
+bool findPathJPS (const Grid& grid, int start, int goal, std::vector<int>& path, PathStats* stats=NULL);
+
+/* findPathJPS() for every query, split into jobs over the job system's
+   workers (see jobs.h); paths[i] is the path of queries[i]. Returns how
+   many were found. */
+struct PathQuery {
+    int start, goal;
+};
+typedef struct PathQuery PathQuery;
+int findPathsJPS (const Grid& grid, const std::vector<PathQuery>& queries, std::vector<std::vector<int> >& paths);
+
+/* One step of a timed route: be in 'cell' at sim tick 'tick' */
+struct TimedStep {
+    int cell;
+    long tick;
+};
+typedef struct TimedStep TimedStep;
+
+/* A* over (cell, tick) that routes through piles while they are down,
+   using the schedule in piles.h. Leaving at 'start_tick', a move to a
+   neighbouring cell takes 'ticks_per_cell' ticks and the destination must
+   stay clear throughout; waiting takes one tick. Pile states repeat every
+   PILE_PERIOD ticks, so states are kept per (cell, tick mod period) and
+   memory stays at cells*PILE_PERIOD however long the horizon. Gives up on
+   routes longer than 'max_ticks'. */
+bool findPathSpaceTime (const Grid& grid, int start, int goal, long start_tick, int ticks_per_cell, long max_ticks,
+                        std::vector<TimedStep>& path, PathStats* stats=NULL);
+
+/* Number of steps in a path returned above */
+inline int pathLength (const std::vector<int>& path) { return path.empty() ? -1 : (int)path.size() - 1; }
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PILES_H
+#define PILES_H
+
+/* Moving piles follow a fixed triangle wave: starting level with the floor
+   they rise 0.1 per sim tick to 0.5, sink to -0.5 and rise again, 20 ticks
+   per cycle. Being analytic, any tick can be looked up directly. */
+const int PILE_PERIOD = 20;
+
+/* Height in tenths above the floor 'tick' ticks after the piles started */
+inline int pileTenths (long tick)
+{
+    int s = (int)((tick + 6) % PILE_PERIOD);
+    return s <= 10 ? s - 5 : 15 - s;
+}
+
+inline float pileHeight (long tick)
+{
+    return pileTenths(tick)*0.1f;
+}
+
+/* A pile blocks the player only while it stands above the floor */
+inline bool pileRaised (long tick)
+{
+    return pileTenths(tick) > 0;
+}
+
+/* The next tick after 'tick' at which piles rise above the floor or sink
+   back level with it */
+inline long pileNextChange (long tick)
+{
+    long next = tick + 1;
+    while (pileRaised(next) == pileRaised(tick))
+        next++;
+    return next;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+
+using namespace std;
+
+const char* const profilePhaseNames[PHASE_COUNT] = {
+    "frame", "draw", "swap", "poll", "tick",
+    "Obstacleblock", "Movingpilesblock", "Jump", "Pitfall", "Win", "Boundary", "Pilesmotion",
+    "path job", "draw job",
+    "player", "hud", "record draws", "capture",
+    "initGLFW", "Generatelevel", "initGL", "create models", "LoadShaders", "compile shader", "link program", "program binary",
+    "gpu draw", "gpu clear", "gpu player", "gpu tiles", "gpu obstacles", "gpu hud",
+};
+
+/* A slot's sequence is odd while its writer fills it in and even once the
+   sample is complete, so a reader can tell a torn slot and skip it */
+struct ProfileSlot {
+    atomic<unsigned long long> seq;
+    atomic<long long> start, end;
+};
+
+static ProfileSlot ring[PHASE_COUNT][PROFILE_RING_SIZE];
+static atomic<unsigned long long> head[PHASE_COUNT];
+
+/* Trace events of one thread. Buffers are registered on first use and
+   outlive their thread so traceFinish() can still write them. */
+struct TraceEvent {
+    int phase;
+    long long start, end;
+};
+
+struct TraceBuffer {
+    int thread;
+    vector<TraceEvent> events;
+};
+
+static atomic<bool> tracing(false);
+static string trace_path;
+static mutex trace_lock;
+static vector<TraceBuffer*> trace_buffers;
+static thread_local TraceBuffer* trace_buffer = NULL;
+
+static void traceAppend (int phase, long long start, long long end)
+{
+    if (!trace_buffer) {
+        lock_guard<mutex> guard(trace_lock);
+        trace_buffer = new TraceBuffer;
+        trace_buffer->thread = trace_buffers.size() + 1;
+        trace_buffers.push_back(trace_buffer);
+    }
+    TraceEvent event = {phase, start, end};
+    trace_buffer->events.push_back(event);
+}
+
+long long profileNow ()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profileRecord (ProfilePhase phase, long long start, long long end)
+{
+    unsigned long long n = head[phase].fetch_add(1, memory_order_relaxed);
+    ProfileSlot& slot = ring[phase][n % PROFILE_RING_SIZE];
+    slot.seq.store(2*n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.start.store(start, memory_order_relaxed);
+    slot.end.store(end, memory_order_relaxed);
+    slot.seq.store(2*n + 2, memory_order_release);
+    if (tracing.load(memory_order_relaxed) && phase < PHASE_GPU_DRAW)
+        traceAppend(phase, start, end);
+}
+
+static double percentile (const vector<long long>& sorted, int p)
+{
+    size_t rank = (sorted.size()*p + 99)/100;
+    return sorted[rank ? rank - 1 : 0]/1e6;
+}
+
+void profileReport (FILE* out)
+{
+    fprintf(out, "%-18s %8s %9s %9s %9s %9s\n", "phase (ms)", "samples", "p50", "p95", "p99", "max");
+    vector<long long> d;
+    for (int p=0; p<PHASE_COUNT; p++) {
+        d.clear();
+        for (int i=0; i<PROFILE_RING_SIZE; i++) {
+            ProfileSlot& slot = ring[p][i];
+            unsigned long long seq = slot.seq.load(memory_order_acquire);
+            if (seq == 0 || seq % 2)
+                continue;
+            long long length = slot.end.load(memory_order_relaxed) - slot.start.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.seq.load(memory_order_relaxed) == seq)
+                d.push_back(length);
+        }
+        if (d.empty())
+            continue;
+        sort(d.begin(), d.end());
+        fprintf(out, "%-18s %8zu %9.3f %9.3f %9.3f %9.3f\n", profilePhaseNames[p], d.size(),
+                percentile(d, 50), percentile(d, 95), percentile(d, 99), d.back()/1e6);
+    }
+}
+
+void traceStart (const char* path)
+{
+    trace_path = path;
+    tracing.store(true);
+}
+
+void traceFinish ()
+{
+    if (!tracing.exchange(false))
+        return;
+    FILE* out = fopen(trace_path.c_str(), "w");
+    if (!out) {
+        perror(trace_path.c_str());
+        return;
+    }
+    // Times in microseconds from the first event
+    lock_guard<mutex> guard(trace_lock);
+    long long origin = -1;
+    for (size_t b=0; b<trace_buffers.size(); b++)
+        for (size_t i=0; i<trace_buffers[b]->events.size(); i++)
+            if (origin == -1 || trace_buffers[b]->events[i].start < origin)
+                origin = trace_buffers[b]->events[i].start;
+
+    long count = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t b=0; b<trace_buffers.size(); b++) {
+        const vector<TraceEvent>& events = trace_buffers[b]->events;
+        for (size_t i=0; i<events.size(); i++, count++)
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    count ? ",\n" : "", profilePhaseNames[events[i].phase], trace_buffers[b]->thread,
+                    (events[i].start - origin)/1e3, (events[i].end - events[i].start)/1e3);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    printf("Wrote %ld trace events to %s\n", count, trace_path.c_str());
+}
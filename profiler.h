@@ -0,0 +1,83 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdio>
+
+/* Phases of a frame and of a sim tick that get timed, then the render
+   passes timed on the GPU (see gputimer.h) */
+enum ProfilePhase {
+    PHASE_FRAME = 0,
+    PHASE_DRAW,
+    PHASE_SWAP,
+    PHASE_POLL,
+    PHASE_TICK,
+    PHASE_OBSTACLEBLOCK,
+    PHASE_MOVINGPILESBLOCK,
+    PHASE_JUMP,
+    PHASE_PITFALL,
+    PHASE_WIN,
+    PHASE_BOUNDARY,
+    PHASE_PILESMOTION,
+    PHASE_PATH_JOB,             // a job of findPathsJPS(), see jobs.h
+    PHASE_DRAW_JOB,             // a job of recordDraws(), see drawlist.h
+    PHASE_PLAYER,
+    PHASE_HUD,
+    PHASE_RECORD_DRAWS,
+    PHASE_CAPTURE,
+    PHASE_INITGLFW,             // start-up, timed once
+    PHASE_GENERATE_LEVEL,
+    PHASE_INITGL,
+    PHASE_CREATE_MODELS,
+    PHASE_LOAD_SHADERS,
+    PHASE_COMPILE_SHADER,
+    PHASE_LINK_PROGRAM,
+    PHASE_PROGRAM_BINARY,       // loading a cached program, see programcache.h
+    PHASE_GPU_DRAW,             // GPU time of the passes below, summed
+    PHASE_GPU_CLEAR,
+    PHASE_GPU_PLAYER,
+    PHASE_GPU_TILES,
+    PHASE_GPU_OBSTACLES,
+    PHASE_GPU_HUD,
+    PHASE_COUNT
+};
+
+extern const char* const profilePhaseNames[PHASE_COUNT];
+
+/* Nanoseconds on a monotonic clock */
+long long profileNow ();
+
+/* Store one timed interval. Safe to call from any thread: writers claim
+   a slot in the phase's ring buffer with one atomic add and never wait.
+   Each ring keeps the most recent PROFILE_RING_SIZE samples of its phase. */
+const int PROFILE_RING_SIZE = 1 << 12;
+void profileRecord (ProfilePhase phase, long long start, long long end);
+
+/* p50/p95/p99 of every phase over the samples still in the ring */
+void profileReport (FILE* out);
+
+/* Trace mode: from traceStart() on, every CPU sample is also kept in full
+   and traceFinish() writes them all to 'path' as Chrome trace JSON, for
+   chrome://tracing or ui.perfetto.dev. GPU phases have no CPU timestamps
+   and are left out of the trace. Call traceFinish() once the other
+   threads have stopped recording. */
+void traceStart (const char* path);
+void traceFinish ();
+
+/* Times the enclosing block */
+struct ProfileScope {
+    ProfilePhase phase;
+    long long start;
+    ProfileScope (ProfilePhase p) : phase(p), start(profileNow()) {}
+    ~ProfileScope () { profileRecord(phase, start, profileNow()); }
+};
+
+/* Building with -DNO_PROFILE removes the timers entirely */
+#ifndef NO_PROFILE
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_JOIN(profile_scope_, __LINE__)(phase)
+#else
+#define PROFILE_SCOPE(phase) do {} while (0)
+#endif
+
+#endif
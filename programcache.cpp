@@ -0,0 +1,156 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "programcache.h"
+#include "profiler.h"
+
+using namespace std;
+
+/* A cache file is this header followed by the driver's binary */
+struct ProgramCacheHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned long long key;
+    unsigned int format;        // the driver's binary format
+    unsigned int length;
+};
+
+static const char CACHE_MAGIC[4] = {'G', 'L', 'P', 'B'};
+const unsigned int CACHE_VERSION = 1;
+
+static bool available ()
+{
+    if (!GLAD_GL_ARB_get_program_binary || !glGetProgramBinary || !glProgramBinary)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+/* 64-bit FNV-1a */
+static unsigned long long hashBytes (unsigned long long hash, const char* bytes, size_t n)
+{
+    for (size_t i=0; i<n; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* The sources and the driver that built the binary. Each string is
+   hashed with its terminator, so one can not run on into the next. */
+static unsigned long long cacheKey (const string& vertex, const string& fragment)
+{
+    unsigned long long key = 14695981039346656037ULL;
+    key = hashBytes(key, vertex.c_str(), vertex.size() + 1);
+    key = hashBytes(key, fragment.c_str(), fragment.size() + 1);
+    const GLenum driver[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (int i=0; i<3; i++) {
+        const char* s = (const char*)glGetString(driver[i]);
+        if (s)
+            key = hashBytes(key, s, strlen(s) + 1);
+    }
+    return key;
+}
+
+/* Makes 'dir' unless it is already there */
+static bool makeDir (const string& dir)
+{
+    if (!mkdir(dir.c_str(), 0755) || errno == EEXIST)
+        return true;
+    perror(dir.c_str());
+    return false;
+}
+
+string programCacheDir ()
+{
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    string dir;
+    if (xdg && *xdg)
+        dir = xdg;
+    else if (home && *home)
+        dir = string(home) + "/.cache";
+    else
+        return "";
+    if (!makeDir(dir) || !makeDir(dir + "/sample2D"))
+        return "";
+    return dir + "/sample2D";
+}
+
+GLuint programCacheLoad (const char* path, const string& vertex, const string& fragment)
+{
+    PROFILE_SCOPE(PHASE_PROGRAM_BINARY);
+    if (!available())
+        return 0;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return 0;
+    ProgramCacheHeader header;
+    vector<char> binary;
+    bool ok = fread(&header, sizeof header, 1, file) == 1 && !memcmp(header.magic, CACHE_MAGIC, 4) &&
+              header.version == CACHE_VERSION && header.key == cacheKey(vertex, fragment) && header.length > 0;
+    if (ok) {
+        binary.resize(header.length);
+        ok = fread(&binary[0], header.length, 1, file) == 1;
+    }
+    fclose(file);
+    if (!ok)
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, &binary[0], header.length);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void programCacheHint (GLuint program)
+{
+    if (available())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void programCacheStore (const char* path, GLuint program, const string& vertex, const string& fragment)
+{
+    if (!available())
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+    ProgramCacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.key = cacheKey(vertex, fragment);
+    header.format = format;
+    header.length = length;
+
+    // Written aside and renamed into place, so a run that stops half way
+    // never leaves a torn binary under the real name
+    string temp = string(path) + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) {
+        perror(temp.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof header, 1, file) == 1 && fwrite(&binary[0], length, 1, file) == 1;
+    ok = !fclose(file) && ok;
+    if (!ok || rename(temp.c_str(), path)) {
+        perror(path);
+        remove(temp.c_str());
+    }
+}
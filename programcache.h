@@ -0,0 +1,32 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <string>
+
+#include <glad/glad.h>
+
+/* Linked shader programs kept on disk with glGetProgramBinary, so a later
+   start loads the driver's own binary instead of compiling. A cache file
+   holds one program and is keyed by a hash of the sources and of the GL
+   vendor, renderer and version strings: a changed shader or driver
+   misses, and the program is compiled and saved again. Drivers may also
+   turn a binary down at load time, which is just another miss. Needs the
+   ARB_get_program_binary extension, advertised even on GL 4.1 and later
+   since glad here only loads up to 3.3, and at least one binary format;
+   without them every load misses and nothing is written. */
+
+/* The per-user directory for cache files, $XDG_CACHE_HOME/sample2D or
+   else ~/.cache/sample2D, made if missing. Empty if there is no such
+   directory and it can not be made. */
+std::string programCacheDir ();
+
+/* The program cached at 'path' for these sources, or 0 on a miss */
+GLuint programCacheLoad (const char* path, const std::string& vertex, const std::string& fragment);
+
+/* Asks the driver to keep 'program's binary; call before linking it */
+void programCacheHint (GLuint program);
+
+/* Writes the linked 'program' to 'path' for these sources */
+void programCacheStore (const char* path, GLuint program, const std::string& vertex, const std::string& fragment);
+
+#endif
@@ -0,0 +1,443 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "sim.h"
+#include "levelgen.h"
+#include "piles.h"
+#include "timerwheel.h"
+#include "profiler.h"
+
+using namespace std;
+
+Rectangle Rectangles[1000];
+Obstacle Obstacles[1000];
+
+float player_rot = 0, dir = 1;
+float x = -7, z = 6, y = 2, t = 0.1;
+int state1 = 0, state2 = 0, state3 = 0, state4 = 0, state5 = 0, state6 = 0, state7 = 0, state8 = 0, space = 0;
+int b[500]={0};
+int a[500]={0};
+int st = 0, st1 = 0;
+int t1 = 0;
+int ntiles = 0, goaltile = 0;
+long piletick = 0;
+TimerWheel simtimers;
+const int npits = 6;
+const int pits[npits][2] = {{2,-1},{0,1},{-3,3},{-2,5},{4,-4},{-2,-1}};
+
+// The piles standing above the floor, in the order they rose, and where
+// each is in that list
+static int raisedpiles[500], raisedat[500];
+static int nraised = 0;
+Grid grid;
+DistanceField goalfield;
+const Level* currentlevel = NULL;
+
+bool Ispit (int j, int k)
+{
+    int cell = worldToCell(grid, j, k);
+    return cell!=-1 && grid.tiles[cell]==TILE_PIT;
+}
+
+/* Place the tiles of the 14x14 field, skipping the pits. Tile i is the one
+   obstacle b[i] and pile a[i] sit on. Piles are left level with the floor;
+   Enterlevel() raises them. The tiles get no models here. */
+void Layouttiles (Level& level)
+{
+    level.ntiles=0;
+    for(int k=-7;k<7;k++)
+        for(int j=-7;j<7;j++)
+        {
+            int tile=level.grid.tiles[worldToCell(level.grid, j, k)];
+            if(tile==TILE_PIT)
+                continue;
+            int i=level.ntiles++;
+            if(j==6&&k==-7)
+                level.goaltile=i;
+            level.tiles[i].x=j;
+            level.tiles[i].z=k;
+            level.tiles[i].y=0;
+            level.tiles[i].rectangle=NULL;
+            level.a[i]=(tile==TILE_PILE);
+            level.b[i]=(tile==TILE_OBSTACLE);
+            level.obstacles[i].x=j;
+            level.obstacles[i].z=k;
+            level.obstacles[i].y=0.5;
+            level.obstacles[i].obstacle=NULL;
+        }
+}
+
+/* Roll piles and obstacles for a new level around the fixed pits. Pits
+   and obstacles go through placeHazards(), which turns down any that
+   would cut the pink goal tile off from the start; the pits come first,
+   so obstacles give way to them. Uses nothing but 'level' and rand(), so
+   it can run on any one thread while the sim plays another level. */
+void Generatelevel (Level& level, bool quiet)
+{
+    PROFILE_SCOPE(PHASE_GENERATE_LEVEL);
+    Grid& grid=level.grid;
+    initGrid(grid, 14, 14, -7, -7);
+    int start=worldToCell(grid, -7, 6), goal=worldToCell(grid, 6, -7);
+    vector<HazardCandidate> candidates;
+    for(int p=0;p<npits;p++)
+    {
+        HazardCandidate pit={worldToCell(grid, pits[p][0], pits[p][1]), TILE_PIT};
+        candidates.push_back(pit);
+    }
+    for(int cell=0;cell<(int)grid.tiles.size();cell++)
+    {
+        if(cell==start||cell==goal)
+            continue;
+        if((rand () % 10)==0)
+            grid.tiles[cell]=TILE_PILE;
+        else if(rand () % 15==0)
+        {
+            HazardCandidate obstacle={cell, TILE_OBSTACLE};
+            candidates.push_back(obstacle);
+        }
+    }
+    int placed=placeHazards(grid, start, goal, candidates);
+    if(!quiet)
+        cout<<"Placed "<<placed<<" of "<<candidates.size()<<" pits and obstacles\n";
+    buildDistanceField(level.goalfield, grid, goal);
+    Layouttiles (level);
+}
+
+void Generatelevel (bool quiet)
+{
+    static Level generated;
+    Generatelevel (generated, quiet);
+    Enterlevel (generated);
+}
+
+/* Play 'level' from the start: its layout goes into the globals, piles at
+   the height the schedule has them now, and the player back at the start */
+void Enterlevel (const Level& level)
+{
+    // Assigning the same sizes again reuses the vectors' memory. The
+    // field's repair scratch is left out; it holds nothing between repairs.
+    grid=level.grid;
+    goalfield.width=level.goalfield.width;
+    goalfield.height=level.goalfield.height;
+    goalfield.goal=level.goalfield.goal;
+    goalfield.dist=level.goalfield.dist;
+    goalfield.next=level.goalfield.next;
+    goalfield.mark=level.goalfield.mark;
+    ntiles=level.ntiles;
+    goaltile=level.goaltile;
+    for(int i=0;i<ntiles;i++)
+    {
+        a[i]=level.a[i];
+        b[i]=level.b[i];
+        Rectangles[i]=level.tiles[i];
+        Obstacles[i]=level.obstacles[i];
+    }
+    Startpiles ();
+    x=-7;
+    z=6;
+    y=2;
+    space=st1=0;
+    player_rot=0;
+    dir=1;
+    currentlevel=&level;
+}
+
+void playeradventure ()
+{
+    if(state1==1)
+        {
+            //if(dir==1)
+            //    x+=t;
+            //else if(dir==2)
+            z-=t;
+            //else if(dir==3)
+            //    x-=t;
+            //else if(dir==4)
+            //    z+=t;
+            dir=2;
+            if(dir==1)
+            {
+                player_rot = 90;
+                dir=2;
+            }
+            else if(dir==3)
+            {
+                player_rot = -90;
+                dir=2;
+            }
+            else if(dir==4)
+            {
+                player_rot = 180;
+                dir=2;
+            }
+        }
+        if(state2==1)
+        {
+            z+=t;
+            dir=4;
+            if(dir==1)
+            {
+                player_rot = -90;
+                dir=4;
+            }
+            if(dir==2)
+            {
+                player_rot = 180;
+                dir=4; 
+            }
+            if(dir==3)
+            {
+                player_rot = 90;
+                dir=4;
+            }
+        }
+        if(state3==1)
+        {
+            x-=t;
+            dir=3;
+            if(dir==1)
+            {
+                player_rot = 180;
+                dir=3;
+            }
+            if(dir==2)
+            {
+                player_rot = 90;
+                dir=3;
+            }
+            if(dir==4)
+            {
+                player_rot = -90;
+                dir=3;
+            }
+        }
+        if(state4==1)
+        {
+            x+=t; 
+            dir=1;
+            if(dir==2)
+            {
+                player_rot = -90;
+                dir=1;
+            }     
+            if(dir==3)
+            {
+                player_rot = 180;
+                dir=1;
+            }
+            if(dir==4)
+            {
+                player_rot = 90;
+                dir=1;
+            }
+        }    
+} 
+
+void playerheaddir ()
+{
+    if(state1==1)
+        {
+            z-=t;
+            
+        }
+        if(state2==1)
+        {
+            z+=t;
+            
+        }
+        if(state3==1)
+        {
+            x-=t;
+            
+        }
+        if(state4==1)
+        {
+            x+=t; 
+            
+        }
+}  
+
+void Obstacleblock ()
+{
+    for(int i=0;i<ntiles;i++)
+        {
+            if(b[i]==1&&space==0)
+            {
+                if(z<=Obstacles[i].z+0.5&&z>=Obstacles[i].z-0.5)
+                {
+                    if(x-Obstacles[i].x<=0.5&&x-Obstacles[i].x>=0.25)
+                        x=Obstacles[i].x+0.5;
+                    else if(Obstacles[i].x-x<=0.5&&Obstacles[i].x-x>=0.25)
+                        x=Obstacles[i].x-0.5;
+                }
+                if(x<=Obstacles[i].x+0.5&&x>=Obstacles[i].x-0.5)
+                {
+                    if(z-Obstacles[i].z<=0.5&&z-Obstacles[i].z>=0.25)
+                        z=Obstacles[i].z+0.5;
+                    else if(Obstacles[i].z-z<=0.5&&Obstacles[i].z-z>=0.25)
+                        z=Obstacles[i].z-0.5;
+                }
+            }
+        }
+
+}
+
+/* Only raised piles block, and only they are looked at */
+void Movingpilesblock ()
+{
+    for(int r=0;r<nraised;r++)
+        {
+            int i=raisedpiles[r];
+            if(space==0)
+            {
+                if(z<=Rectangles[i].z+0.5&&z>=Rectangles[i].z-0.5)
+                {
+                    if(x-Rectangles[i].x<=0.75&&x-Rectangles[i].x>=0.5)
+                        x=Rectangles[i].x+0.75;
+                    else if(Rectangles[i].x-x<=0.75&&Rectangles[i].x-x>=0.5)
+                        x=Rectangles[i].x-0.75;
+                }
+                if(x<=Rectangles[i].x+0.75&&x>=Rectangles[i].x-0.75)
+                {
+                    if(z-Rectangles[i].z<=0.75&&z-Rectangles[i].z>=0.5)
+                        z=Rectangles[i].z+0.75;
+                    else if(Rectangles[i].z-z<=0.75&&Rectangles[i].z-z>=0.5)
+                        z=Rectangles[i].z-0.75;
+                }
+            }
+        }
+        
+}
+
+void Jump ()
+{
+    if(space==1)
+        {
+            if(y<2.8 && st1==0)
+            {
+                y+=0.1;
+                st1=0;
+            }
+            else if(y>2)
+            {
+                st1=1;
+                y-=0.1;
+            }
+            if(y>2 && st1==0)
+            {
+                y+=0.1;
+                st1=0;
+            }
+            else if(y>2)
+            {
+                st1=1;
+                y-=0.1;
+            }
+            if(y<=2 && st1==1)
+            {
+                space=0;
+                st1=0;
+            }
+
+        }
+        
+}
+
+void Pitfall ()
+{
+    int cell = worldToCell(grid, x, z);
+    if(space==0 && cell!=-1 && grid.tiles[cell]==TILE_PIT && fabs(x-(grid.origin_x+cellX(grid, cell)))<=0.25 && fabs(z-(grid.origin_z+cellZ(grid, cell)))<=0.25)
+        {
+            y-=0.5;
+            space=0;
+        }
+        //else if(space==0)
+        //    y=2;
+        if(y<=0)
+        {
+            Exitgame ();
+        }
+}
+
+void Win ()
+{
+    if(x>=6&&z<=-7&&Nextlevel ())
+        {
+            cout<<"Level won\n";
+        }
+}
+
+void Boundary ()
+{
+    if(z<=-7.25)
+        z=-7.25;
+    if(z>=6.25)
+        z=6.25;
+    if(x<=-7.25)
+        x=-7.25;
+    if(x>=6.25)
+        x=6.25;
+}
+
+void Takesnapshot (SimSnapshot& s)
+{
+    s.time=profileNow();
+    s.x=x;
+    s.y=y;
+    s.z=z;
+    s.level=currentlevel;
+    s.player_rot=player_rot;
+    s.speed=t;
+    s.piletick=piletick;
+    s.ntiles=ntiles;
+    for(int i=0;i<ntiles;i++)
+        s.tiley[i]=a[i] ? pileHeight(piletick) : Rectangles[i].y;
+}
+
+/* Pile i rising above the floor or sinking back level with it. The pile
+   then sleeps on the timer wheel until its next change. */
+static void Pilechange (int i, long tick)
+{
+    if(pileRaised(tick))
+    {
+        raisedat[i]=nraised;
+        raisedpiles[nraised++]=i;
+    }
+    else
+    {
+        int last=raisedpiles[--nraised];
+        raisedpiles[raisedat[i]]=last;
+        raisedat[last]=raisedat[i];
+    }
+    timerSchedule(simtimers, pileNextChange(tick), Pilechange, i);
+}
+
+/* Raise the piles the schedule has up at piletick and give every pile a
+   timer for its next change, dropping any timers of the last level */
+void Startpiles ()
+{
+    timerInit(simtimers, 500, piletick);
+    nraised=0;
+    for(int i=0;i<ntiles;i++)
+    {
+        if(a[i]!=1)
+            continue;
+        if(pileRaised(piletick))
+        {
+            raisedat[i]=nraised;
+            raisedpiles[nraised++]=i;
+        }
+        timerSchedule(simtimers, pileNextChange(piletick), Pilechange, i);
+    }
+}
+
+/* Piles follow the fixed schedule in piles.h, so routes can be planned
+   around them ahead of time. Heights are looked up from the schedule and
+   a pile only costs a tick when its timer runs, as it rises or sinks. */
+void Pilesmotion ()
+{
+    piletick++;
+    timerAdvance(simtimers, piletick);
+}
@@ -0,0 +1,108 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "maze.h"
+#include "flowfield.h"
+#include "timerwheel.h"
+
+/* Game state and the functions run on every sim tick. Nothing in here
+   touches GL, so the tick can be run and measured without a window. */
+
+struct VAO;
+
+/* Tile i of the field: its floor and the obstacle on it, if b[i] is set.
+   A pile's height is not kept here but looked up from the schedule in
+   piles.h when it is needed. */
+struct Rectangle
+{
+    float x,y=0,z;
+    VAO *rectangle;
+};
+typedef struct Rectangle Rectangle;
+extern Rectangle Rectangles[1000];
+
+struct Obstacle
+{
+    float x,y,z;
+    VAO *obstacle;
+};
+typedef struct Obstacle Obstacle;
+extern Obstacle Obstacles[1000];
+
+extern float player_rot, dir;
+extern float x, z, y, t;
+extern int state1, state2, state3, state4, state5, state6, state7, state8, space;
+extern int b[500];              // tile i carries an obstacle
+extern int a[500];              // tile i is a moving pile
+extern int st, st1;
+extern int t1;
+extern int ntiles, goaltile;
+extern long piletick;
+extern TimerWheel simtimers;    // on piletick
+extern Grid grid;
+extern DistanceField goalfield;
+
+/* Everything a level is made of. A level is generated into one of these,
+   off the sim thread if need be, and Enterlevel() copies it into the
+   globals above for the sim to play. The Level itself stays unchanged
+   while it is played, so a renderer can read its tiles and models. */
+struct Level
+{
+    Grid grid;
+    DistanceField goalfield;
+    int ntiles, goaltile;
+    int a[500], b[500];
+    Rectangle tiles[1000];
+    Obstacle obstacles[1000];
+};
+typedef struct Level Level;
+extern const Level* currentlevel;   // entered last
+
+bool Ispit (int j, int k);
+void Layouttiles (Level& level);
+void Generatelevel (Level& level, bool quiet=false);
+void Generatelevel (bool quiet=false);  // and enter it
+void Enterlevel (const Level& level);
+void Startpiles ();             // called by Enterlevel()
+
+void playeradventure ();
+void playerheaddir ();
+void Obstacleblock ();
+void Movingpilesblock ();
+void Jump ();
+void Pitfall ();
+void Win ();
+void Boundary ();
+void Pilesmotion ();
+
+/* Everything draw() needs from one tick, copied out so a renderer on
+   another thread never reads state the sim is changing. Tile positions
+   and obstacles only change with the level and are read from 'level'. */
+struct SimSnapshot
+{
+    long tick;
+    long long time;             // profileNow() when taken
+    const Level* level;
+    float x, y, z, player_rot;
+    float speed;                // t
+    long piletick;
+    int ntiles;
+    float tiley[1000];          // Rectangles[i].y
+    unsigned long inputs;       // inputs acted on so far, see latency.h
+};
+typedef struct SimSnapshot SimSnapshot;
+
+/* Fills in everything but 'tick' and 'inputs' */
+void Takesnapshot (SimSnapshot& s);
+
+/* Called on reaching the goal to start the next level, and defined by the
+   program running the sim. Returns false if it is not ready yet; the
+   player then stays on the goal and the next tick tries again. */
+bool Nextlevel ();
+
+/* Ends the game; defined by the program running the sim. When the sim has
+   a thread of its own this may return, having asked the program to stop
+   after the current tick. */
+void Exitgame ();
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/* A fixed ring of N values passed in order from one producer thread to one
+   consumer thread, with no locks and no waiting on either side. push() on
+   a full queue fails instead of blocking. The consumer looks at the oldest
+   value with peek() and frees its slot with pop() once done with it. The
+   two counters only ever grow and sit on separate cache lines so the two
+   threads do not keep taking the line from each other. */
+template <class T, int N>
+class SpscQueue {
+public:
+    SpscQueue () : head(0), tail(0) {}
+
+    bool push (const T& value)          // producer
+    {
+        unsigned long t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        slots[t % N] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    const T* peek ()                    // consumer
+    {
+        unsigned long h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return NULL;
+        return &slots[h % N];
+    }
+
+    void pop ()                         // consumer, after peek() found a value
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    T slots[N];
+    alignas(64) std::atomic<unsigned long> head;    // values taken
+    alignas(64) std::atomic<unsigned long> tail;    // values pushed
+};
+
+#endif
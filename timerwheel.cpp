@@ -0,0 +1,108 @@
+#include "timerwheel.h"
+
+static void unlink (TimerWheel& wheel, int t, int& head)
+{
+    Timer& timer = wheel.timers[t];
+    if (timer.prev != -1)
+        wheel.timers[timer.prev].next = timer.next;
+    else
+        head = timer.next;
+    if (timer.next != -1)
+        wheel.timers[timer.next].prev = timer.prev;
+}
+
+static void link (TimerWheel& wheel, int t, int& head)
+{
+    Timer& timer = wheel.timers[t];
+    timer.prev = -1;
+    timer.next = head;
+    if (head != -1)
+        wheel.timers[head].prev = t;
+    head = t;
+}
+
+/* Puts a timer in the slot its due tick calls for as of now. Level L
+   takes timers due less than 64^(L+1) ticks ahead, and the clock reaches
+   their slot no later than 64^L ticks before they are due, in time to
+   move them down. Past the top level's span a timer goes round the top
+   level again. */
+static void place (TimerWheel& wheel, int t)
+{
+    Timer& timer = wheel.timers[t];
+    long ahead = timer.due - wheel.now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && ahead >> (TIMER_SLOT_BITS*(level + 1)))
+        level++;
+    timer.slot = level*TIMER_SLOTS + ((timer.due >> (TIMER_SLOT_BITS*level)) & (TIMER_SLOTS - 1));
+    link(wheel, t, wheel.slots[timer.slot]);
+}
+
+void timerInit (TimerWheel& wheel, int capacity, long now)
+{
+    if ((int)wheel.timers.size() < capacity)
+        wheel.timers.resize(capacity);
+    wheel.now = now;
+    wheel.pending = 0;
+    for (int s=0; s<TIMER_LEVELS*TIMER_SLOTS; s++)
+        wheel.slots[s] = -1;
+    wheel.free = -1;
+    for (int t=(int)wheel.timers.size() - 1; t>=0; t--)
+        link(wheel, t, wheel.free);
+}
+
+int timerSchedule (TimerWheel& wheel, long due, TimerFunction fn, int entity)
+{
+    int t = wheel.free;
+    if (t == -1)
+        return -1;
+    unlink(wheel, t, wheel.free);
+    Timer& timer = wheel.timers[t];
+    timer.due = due > wheel.now ? due : wheel.now + 1;
+    timer.fn = fn;
+    timer.entity = entity;
+    place(wheel, t);
+    wheel.pending++;
+    return t;
+}
+
+void timerCancel (TimerWheel& wheel, int t)
+{
+    unlink(wheel, t, wheel.slots[wheel.timers[t].slot]);
+    link(wheel, t, wheel.free);
+    wheel.pending--;
+}
+
+void timerAdvance (TimerWheel& wheel, long now)
+{
+    while (wheel.now < now) {
+        long tick = ++wheel.now;
+
+        // At the start of a level's slot, its timers move down. They are
+        // all due within the slot, so none stay at this level.
+        for (int l=1; l<TIMER_LEVELS; l++) {
+            if (tick & ((1L << (TIMER_SLOT_BITS*l)) - 1))
+                break;
+            int& slot = wheel.slots[l*TIMER_SLOTS + ((tick >> (TIMER_SLOT_BITS*l)) & (TIMER_SLOTS - 1))];
+            int t = slot;
+            slot = -1;
+            while (t != -1) {
+                int next = wheel.timers[t].next;
+                place(wheel, t);
+                t = next;
+            }
+        }
+
+        // Everything left in this tick's level 0 slot is due now. The list
+        // is taken off the slot first, as timers run may schedule into it.
+        int& slot = wheel.slots[tick & (TIMER_SLOTS - 1)];
+        int t = slot;
+        slot = -1;
+        while (t != -1) {
+            Timer timer = wheel.timers[t];
+            link(wheel, t, wheel.free);
+            wheel.pending--;
+            timer.fn(timer.entity, tick);
+            t = timer.next;
+        }
+    }
+}
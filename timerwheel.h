@@ -0,0 +1,55 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <vector>
+
+/* Timers on sim ticks, for entities that change state now and then and
+   sleep in between: each schedules a call at its next change and costs
+   nothing until then. The timers sit in a hierarchical timing wheel.
+   Level 0 has a slot for each of the next 64 ticks, level 1 a slot for
+   each 64 ticks of the next 4096, and so on up to 2^24 ticks ahead. A
+   timer goes into the finest level whose span covers it; when the clock
+   reaches the start of a coarser slot, that slot's timers move down a
+   level or more. Scheduling and cancelling are O(1), and a tick costs the
+   timers due plus those moving down. Timers come from a pool sized by
+   timerInit(), so nothing is allocated after it. */
+
+typedef void (*TimerFunction) (int entity, long tick);
+
+const int TIMER_LEVELS = 4;
+const int TIMER_SLOT_BITS = 6;
+const int TIMER_SLOTS = 1 << TIMER_SLOT_BITS;
+
+struct Timer {
+    long due;
+    TimerFunction fn;
+    int entity;
+    int slot;                   // index into TimerWheel::slots while scheduled
+    int next, prev;             // in its slot's list, or the free list
+};
+
+struct TimerWheel {
+    long now;
+    std::vector<Timer> timers;  // the pool
+    int free;                   // first unused timer, -1 if none
+    int pending;
+    int slots[TIMER_LEVELS*TIMER_SLOTS];   // first timer of each slot by level, -1 if none
+};
+
+/* Drops every timer and sets the clock to 'now'. The pool only allocates
+   when it grows past what an earlier call made it. */
+void timerInit (TimerWheel& wheel, int capacity, long now);
+
+/* Calls fn(entity, tick) once the clock reaches 'due', or on the next
+   tick if that has passed. Returns the timer, or -1 if the pool is full.
+   Timers due on the same tick run in no set order. */
+int timerSchedule (TimerWheel& wheel, long due, TimerFunction fn, int entity);
+
+/* Drops a timer that has not run yet */
+void timerCancel (TimerWheel& wheel, int timer);
+
+/* Moves the clock forward to 'now', running the timers due on the way.
+   A running timer may schedule others, itself again included. */
+void timerAdvance (TimerWheel& wheel, long now);
+
+#endif
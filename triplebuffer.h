@@ -0,0 +1,40 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/* Hands the latest value from one writer thread to one reader thread with
+   no locks and no waiting on either side. The writer fills its own slot
+   and publish() swaps it with the middle one; read() takes the middle slot
+   for the reader only if something newer was published since. Each side
+   only touches the slot it holds, so what read() returns stays unchanged
+   until the reader's next read(). A slot handed back to the writer holds
+   an old value: fill it completely before publishing. */
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer () : middle(1), back(0), front(2) {}
+
+    T& writeSlot () { return slots[back]; }
+
+    void publish ()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    const T& read ()
+    {
+        if (middle.load(std::memory_order_relaxed) & FRESH)
+            front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        return slots[front];
+    }
+
+private:
+    static const int FRESH = 4;     // set in 'middle' until the reader takes it
+    T slots[3];
+    std::atomic<int> middle;
+    int back;                       // the writer's slot
+    int front;                      // the reader's slot
+};
+
+#endif